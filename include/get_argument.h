@@ -26,24 +26,81 @@
 #define GET_ARGUMENTS_H
 
 // ------------------------------------------------------------------------- //
-#include <windows.h>
+#include <algorithm>
+#include <cstdint>
+#include <cwctype>
 #include <string>
-#include <regex>
+#include <string_view>
 #include <vector>
 
-#define QUOTE_REGEX     L"((?:^|[^\\\\])(?:\\\\{2})*)\""
-#define WORD_REGEX      L"[^\\s=]+"
+// The prefix scan compares 8 characters at once where wchar_t is UTF-16 and
+// SSE2 is available, i.e. on every x86 Windows build
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define ARGUMENT_SSE2
+#endif
 
 using namespace std;
 
 
+// --------------------------- Argument List ------------------------------- //
+// Arguments are spans over the command line rather than copies of it: an
+// offset, a length and whether it is an argument or the separator (white
+// space or '=') between two. Removing an argument only sets a bit, and the
+// surviving spans are copied into one buffer when collapsed, so nothing is
+// allocated per argument. The command line must outlive the list, which is a
+// given for GetCommandLineW().
+enum ArgumentKind : uint8_t {
+  ARGUMENT_WORD,
+  ARGUMENT_SEPARATOR
+};
+
+struct ArgumentSpan {
+  uint32_t      offset;
+  uint32_t      length;
+  ArgumentKind  kind;
+};
+
+class ArgumentList {
+public:
+  ArgumentList(wstring_view line = {}) : line(line) {}
+
+  size_t size() const                   { return spans.size(); }
+  wstring_view operator[](size_t i) const {
+    return line.substr(spans[i].offset, spans[i].length);
+  }
+  bool isWord(size_t i) const     { return spans[i].kind == ARGUMENT_WORD; }
+  bool isRemoved(size_t i) const  { return removed[i / 64] >> (i % 64) & 1; }
+  void remove(size_t i)           { removed[i / 64] |= uint64_t(1) << (i % 64); }
+
+  void add(size_t offset, size_t length, ArgumentKind kind) {
+    spans.push_back({(uint32_t)offset, (uint32_t)length, kind});
+    if (removed.size() * 64 < spans.size())
+      removed.push_back(0);
+  }
+
+  // Index of the next argument still in the list at or after I
+  size_t nextWord(size_t i) const {
+    while (i < size() && (isRemoved(i) || !isWord(i)))
+      i++;
+    return i;
+  }
+
+private:
+  wstring_view          line;
+  vector<ArgumentSpan>  spans;
+  vector<uint64_t>      removed;
+};
+
+
 /**@brief  Splits a string into a list of arguments
  * 
  * In the simplest form this function splits a string at word boundaries (i.e.
- * \s) preserving the white spaces. The more complex cases arise with double
+ * \s or =) preserving the separators. The more complex cases arise with double
  * quotes which, if not escaped, denote a full argument. Escaped quotes and
  * quotes within words are ignored regardless. In all cases, the parsing is
- * lossless allowing reconstruction of the input.
+ * lossless allowing reconstruction of the input (trailing separators aside,
+ * which are dropped).
  *
  * Example:
  * 'arg1  arg2 "arg 3"   arg"4' -->
@@ -57,146 +114,209 @@ using namespace std;
  * 
  * @param  ARG_LINE:    command line to parse, i.e. GetCommandLineW()
  * 
- * @return vector of strings including the whitespaces
+ * @return list of spans over ARG_LINE including the separators
  */
-vector<wstring> ParseArguments (wstring arg_line) {
-  // Initialize the parsed list of strings to be returned
-  vector<wstring>
-    output          = {};
-
-  // Regex and Iterators
-  wregex
-    regex_word(WORD_REGEX),
-    regex_quote(QUOTE_REGEX);
-
-  regex_iterator<wstring::iterator>
-    iter_word(arg_line.begin(), arg_line.end(), regex_word),
-    iter_quote(arg_line.begin(), arg_line.end(), regex_quote),
-    iter_end;
-
-  // Cursor positions as we step through the string
-  wstring::size_type
-    // beginning of word
-    pos_word_0      = 0,
-    // end of word
-    pos_word_1      = 0,
-    // beginning of quote
-    pos_quote       = iter_quote->position() + iter_quote->length() - 1;
-  
-  // Quote count (though mainly used to identify if within quotes)
-  int
-    cnt_quote       = 0;
-
-
-  // Iterate through each word
-  while(iter_word != iter_end) {
-    // If the beginning position is ahead of the end,
-    // its a whitespace so add it to the output
-    if(pos_word_1 < pos_word_0)
-      output.push_back(arg_line.substr(pos_word_1, pos_word_0 - pos_word_1));
-    
-    // Find end of this word 
-    pos_word_1 = iter_word->position() + iter_word->length();
-
-    // If the quote is within this word...
-    while(pos_word_0 <= pos_quote && pos_quote < pos_word_1 &&
-          iter_quote != iter_end) {
-
-      // Check if the quote is at the beginning or end of the word because
-      // *technically* you could have a quote in the middle of a word (who would
-      // do such a thing?!?!) in which case, we'll ignore
-      if (pos_word_0 == pos_quote || pos_quote == pos_word_1 - 1) cnt_quote++;
-
-      // Find the next quote position
-      // (which may still be within the current word)
-      iter_quote++;
-      pos_quote = iter_quote->position() + iter_quote->length() - 1;
-    }
-
-    // Increment to the next word
-    iter_word++;
-
-    // If we are not within quotes, we are at the end of an argument
-    if((cnt_quote % 2) < 1) {
-      // Add the argument to the output
-      output.push_back(arg_line.substr(pos_word_0, pos_word_1 - pos_word_0));
-
-      // Find the start of the next word
-      pos_word_0 = iter_word->position();
+ArgumentList ParseArguments (wstring_view arg_line) {
+  ArgumentList output(arg_line);
+  size_t length = arg_line.size();
+  size_t pos    = 0;
+
+  auto separator = [&](size_t i) {
+    return arg_line[i] == L'=' || iswspace(arg_line[i]);
+  };
+
+  // A quote is escaped by an odd number of backslashes before it
+  auto quote = [&](size_t i) {
+    if (arg_line[i] != L'"')
+      return false;
+    size_t slashes = 0;
+    while (slashes < i && arg_line[i - slashes - 1] == L'\\')
+      slashes++;
+    return slashes % 2 == 0;
+  };
+
+  while (pos < length) {
+    // Separator up to the next argument
+    size_t start = pos;
+    while (pos < length && separator(pos))
+      pos++;
+    if (pos == length)
+      break;
+    if (pos > start)
+      output.add(start, pos - start, ARGUMENT_SEPARATOR);
+
+    // An argument is one word, or several while a quote is open. Only quotes
+    // at the start of the argument or the end of a word count.
+    size_t begin  = pos;
+    int    quotes = 0;
+    while (pos < length) {
+      size_t word = pos;
+      while (pos < length && !separator(pos))
+        pos++;
+
+      if (word == begin && quote(word))
+        quotes++;
+      if (pos - 1 != begin && quote(pos - 1))
+        quotes++;
+
+      if (quotes % 2 == 0)
+        break;
+      while (pos < length && separator(pos))
+        pos++;
     }
+    output.add(begin, pos - begin, ARGUMENT_WORD);
   }
 
   return output;
 }
 
 
-/**@brief  Combines parsed arguments into a single string
+/**@brief  Combines the remaining arguments into a single string
  * 
- * @param  PARSED_ARGS: vector of strings
+ * @param  PARSED_ARGS: list from ParseArguments
  *
- * @return string = PARSED_ARGS[0] + PARSED_ARGS[1] + ...
+ * @return string = PARSED_ARGS[0] + PARSED_ARGS[1] + ... (skipping removed)
  */
-wstring CollapseArguments (vector<wstring> parsed_args) {
-  wstring output = L"";
-  for (auto iter = parsed_args.begin(); iter != parsed_args.end(); ++iter) 
-    output += *iter;
+wstring CollapseArguments (const ArgumentList &parsed_args) {
+  size_t length = 0;
+  for (size_t i = 0; i < parsed_args.size(); i++)
+    if (!parsed_args.isRemoved(i))
+      length += parsed_args[i].size();
+
+  wstring output;
+  output.reserve(length);
+  for (size_t i = 0; i < parsed_args.size(); i++)
+    if (!parsed_args.isRemoved(i))
+      output += parsed_args[i];
   return output; 
 }
 
 
-/**@brief  Collapse and re-parse a list of arguments
- * 
- * Needed for finding positional arguments after some parsing has been done
- * 
- * @param  PARSED_ARGS: vector of strings
+// Removes the span at I and the separator after it, if any
+void RemoveArgument (ArgumentList &args, size_t i) {
+  args.remove(i);
+  if (i + 1 < args.size() && !args.isWord(i + 1))
+    args.remove(i + 1);
+}
+
+
+// Compares C, ignoring case, with ONE: a character, an escaped one (\?), any
+// (.) or a class of characters and ranges ([a-z])
+bool MatchCharacter (wchar_t c, wstring_view one) {
+  if (one == L".")
+    return true;
+  wint_t lower = towlower(c);
+  if (one.front() != L'[')
+    return lower == towlower(one.back());
+
+  wstring_view set = one.substr(1, one.size() - 2);
+  for (size_t i = 0; i < set.size(); i++) {
+    if (i + 2 < set.size() && set[i + 1] == L'-') {
+      if (lower >= towlower(set[i]) && lower <= towlower(set[i + 2]))
+        return true;
+      i += 2;
+    }
+    else if (lower == towlower(set[i]))
+      return true;
+  }
+  return false;
+}
+
+
+/**@brief  Matches an argument against a flag pattern, ignoring case
+ *
+ * PATTERN is the part of regex syntax the flags are written in: characters,
+ * escaped characters, any character (.), classes ([a-z]), * after any of
+ * those, and one level of alternatives ((c|-command)). The whole argument
+ * has to match. Unlike wregex nothing is allocated, neither to compile the
+ * pattern nor to match a long argument against it.
+ *
+ * @param  ARG:     argument to test
+ * @param  PATTERN: flag pattern, e.g. L"-(p|-path)" or L"--shim.*"
+ * @param  REST:    pattern still to match after PATTERN (used for groups)
+ *
+ * @return TRUE if ARG matches
  */
-void ReparseArguments (vector<wstring> &parsed_args) {
-  wstring arg_line = CollapseArguments(parsed_args);
-  parsed_args = ParseArguments(arg_line);
+bool MatchArgument (wstring_view arg, wstring_view pattern,
+                    wstring_view rest = {}) {
+  if (pattern.empty())
+    return rest.empty() ? arg.empty() : MatchArgument(arg, rest);
+
+  // One of the alternatives, then whatever follows the group
+  if (pattern.front() == L'(') {
+    size_t close        = pattern.find(L')');
+    wstring_view group  = pattern.substr(1, close - 1);
+    wstring_view after  = pattern.substr(close + 1);
+    for (size_t start = 0; start <= group.size(); ) {
+      size_t bar = min(group.find(L'|', start), group.size());
+      if (MatchArgument(arg, group.substr(start, bar - start), after))
+        return true;
+      start = bar + 1;
+    }
+    return false;
+  }
+
+  size_t length = pattern.front() == L'[' ? pattern.find(L']') + 1 :
+                  pattern.front() == L'\\' ? 2 : 1;
+  wstring_view one    = pattern.substr(0, length);
+  bool repeat         = length < pattern.size() && pattern[length] == L'*';
+  wstring_view after  = pattern.substr(length + repeat);
+
+  if (!repeat)
+    return !arg.empty() && MatchCharacter(arg.front(), one) &&
+           MatchArgument(arg.substr(1), after, rest);
+
+  // As few as possible first; a failed character ends the repeat
+  for (size_t n = 0; ; n++) {
+    if (MatchArgument(arg.substr(n), after, rest))
+      return true;
+    if (n == arg.size() || !MatchCharacter(arg[n], one))
+      return false;
+  }
 }
 
   
 /**@brief  Get and remove an argument at a certain position
  *
- * Finds the nth string from ARGS excluding whitespace elements. If the element
- * is found (i.e. within bounds), store as VALUE and removed from ARGS. If
- * subsequent whitespace exist, removed also. 
+ * Finds the nth argument remaining in ARGS, excluding separators. If the
+ * element is found (i.e. within bounds), store as VALUE and removed from ARGS.
+ * If a subsequent separator exists, it is removed also.
  *
- * @param  ARGS:    vector of strings from ParseArguments
+ * @param  ARGS:    list from ParseArguments
  * @param  INDEX:   index of argument to get
  * @param  VALUE:   string at index
  *
  * @return TRUE if found
  */
-bool GetArgument (vector<wstring> &args, const int index, wstring &value) {
+bool GetArgument (ArgumentList &args, const int index, wstring &value) {
   value.clear();
-  if((index*2) < args.size()) {
-    args[index*2].swap(value);
-    if((index*2)+1 < args.size()) args[(index*2)+1].clear();
-    return true;
-  }
-  return false;
+  size_t i = args.nextWord(0);
+  for (int n = 0; n < index && i < args.size(); n++)
+    i = args.nextWord(i + 1);
+  if (i >= args.size())
+    return false;
+
+  value = args[i];
+  RemoveArgument(args, i);
+  return true;
 }
 
 
 /**@brief  Get and remove a flag matching a pattern
  *
- * Finds the string matching PATTERN, ignoring case, within ARGS. If the element
- * is found, removed from ARGS in addition to subsequent whitespace if exist.
+ * Finds the argument matching PATTERN, ignoring case, within ARGS. If the
+ * element is found, removed from ARGS in addition to the subsequent separator
+ * if it exists.
  * 
- * @param  ARGS:    vector of strings from ParseArguments
- * @param  PATTERN: regex pattern to match
+ * @param  ARGS:    list from ParseArguments
+ * @param  PATTERN: pattern to match, see MatchArgument
  *
  * @return TRUE if found
  */
-bool GetArgument (vector<wstring> &args, wstring pattern) {
-  // User-specified argument regex
-  wregex arg_pattern(pattern, regex::icase);
-
-  for (auto iter = args.begin(); iter != args.end(); ++iter) {
-    if(regex_match(*iter, arg_pattern)) {
-      (*iter).clear();                          // Clear the flag
-      if(++iter != args.end()) (*iter).clear(); // Clear whitespace if needed
+bool GetArgument (ArgumentList &args, wstring_view pattern) {
+  for (size_t i = args.nextWord(0); i < args.size(); i = args.nextWord(i + 1)) {
+    if (MatchArgument(args[i], pattern)) {
+      RemoveArgument(args, i);
       return true;
     }
   }
@@ -207,30 +327,28 @@ bool GetArgument (vector<wstring> &args, wstring pattern) {
 
 /**@brief  Get and remove a named argument matching a pattern
  *
- * Finds the string matching PATTERN, ignoring case, within ARGS. If the element
- * is found, the next argument is retrieved and stored as VALUE. The match,
- * value, whitespace separating the two are removed from ARGS in addition to
- * subsequent whitespace if exist. TRUE is only returned if the match is found
- * AND an argument follows.
- * 
- * @param  ARGS:    vector of strings from ParseArguments
- * @param  PATTERN: regex pattern to match
+ * Finds the argument matching PATTERN, ignoring case, within ARGS. If the
+ * element is found, the next argument is retrieved and stored as VALUE. The
+ * match, value, separator between the two are removed from ARGS in addition
+ * to the subsequent separator if it exists. TRUE is only returned if the match
+ * is found AND an argument follows.
+ *
+ * @param  ARGS:    list from ParseArguments
+ * @param  PATTERN: pattern to match, see MatchArgument
  * @param  VALUE:   argument string following match
  *
  * @return TRUE if pattern and value are found
  */
-bool GetArgument (vector<wstring> &args, wstring pattern,wstring &value) {
+bool GetArgument (ArgumentList &args, wstring_view pattern, wstring &value) {
   value.clear();
 
-  // User-specified argument regex
-  wregex arg_pattern(pattern, regex::icase);
-
-  for (auto iter = args.begin(); iter != args.end(); ++iter) {
-    if(regex_match(*iter, arg_pattern) && (iter+2) < args.end()) {
-      (*iter).clear();                          // Clear the flag
-      (*(++iter)).clear();                      // Clear the whitespace
-      (*(++iter)).swap(value);                  // Get the value and clear
-      if(++iter != args.end()) (*iter).clear(); // Clear whitespace if needed
+  for (size_t i = args.nextWord(0); i < args.size(); i = args.nextWord(i + 1)) {
+    if (MatchArgument(args[i], pattern) &&
+        i + 2 < args.size() && !args.isRemoved(i + 2) && args.isWord(i + 2)) {
+      value = args[i + 2];
+      args.remove(i);                           // Clear the flag
+      args.remove(i + 1);                       // Clear the separator
+      RemoveArgument(args, i + 2);              // Value and separator after
       return true;
     }
   }
@@ -239,6 +357,109 @@ bool GetArgument (vector<wstring> &args, wstring pattern,wstring &value) {
 }
 
 
+/**@brief  Get and remove all remaining arguments
+ *
+ * Takes every argument left in ARGS, with surrounding quotes removed. Used
+ * for commands taking a list of paths once all flags are parsed.
+ *
+ * @param  ARGS:    list from ParseArguments
+ *
+ * @return the arguments in order
+ */
+vector<wstring> GetRemainingArguments (ArgumentList &args) {
+  vector<wstring> values;
+  for (size_t i = 0; i < args.size(); i++) {
+    if (!args.isRemoved(i) && args.isWord(i)) {
+      wstring_view arg = args[i];
+      if (arg.size() > 1 && arg.front() == L'"' && arg.back() == L'"')
+        arg = arg.substr(1, arg.size() - 2);
+      values.emplace_back(arg);
+    }
+    args.remove(i);
+  }
+  return values;
+}
+
+
+
+// ----------------------------- Fast Path --------------------------------- //
+/**@brief  Skips the program name at the start of a command line
+ *
+ * Follows the CRT's rules for argv[0]: quotes toggle quoting anywhere in it,
+ * backslashes have no special meaning, and it ends at the first space or tab
+ * outside quotes. The white space after it is skipped too.
+ *
+ * @param  LINE:    command line, i.e. GetCommandLineW()
+ *
+ * @return the rest of LINE, exactly as given
+ */
+wstring_view ArgumentTail (wstring_view line) {
+  size_t pos        = 0;
+  bool   in_quotes  = false;
+  for (; pos < line.size(); pos++) {
+    if (line[pos] == L'"')
+      in_quotes = !in_quotes;
+    else if (!in_quotes && (line[pos] == L' ' || line[pos] == L'\t'))
+      break;
+  }
+  while (pos < line.size() && (line[pos] == L' ' || line[pos] == L'\t'))
+    pos++;
+  return line.substr(pos);
+}
+
+
+// Whether PREFIX (lower case) is at I, ignoring the case of ASCII letters
+inline bool MatchesPrefix (wstring_view line, size_t i, wstring_view prefix) {
+  if (line.size() - i < prefix.size())
+    return false;
+  for (size_t k = 0; k < prefix.size(); k++) {
+    wchar_t c = line[i + k];
+    if (c >= L'A' && c <= L'Z')
+      c += L'a' - L'A';
+    if (c != prefix[k])
+      return false;
+  }
+  return true;
+}
+
+/**@brief  Checks for a prefix anywhere in a string, ignoring case
+ *
+ * Used to find out whether a command line holds any --shim flags at all
+ * before paying for parsing it. Candidates for the first character (which is
+ * matched exactly, so it should not be a letter) are found 8 at a time.
+ *
+ * @param  LINE:    string to search
+ * @param  PREFIX:  lower case prefix, e.g. SHIM_ARG_PREFIX
+ *
+ * @return TRUE if found
+ */
+bool ContainsPrefix (wstring_view line, wstring_view prefix) {
+  if (prefix.empty())
+    return true;
+  if (line.size() < prefix.size())
+    return false;
+
+  size_t i = 0;
+#ifdef ARGUMENT_SSE2
+  if constexpr (sizeof(wchar_t) == 2) {
+    const __m128i first = _mm_set1_epi16((short)prefix[0]);
+    for (; i + 8 <= line.size(); i += 8) {
+      __m128i chunk = _mm_loadu_si128((const __m128i *)(line.data() + i));
+      unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi16(chunk, first));
+
+      // Two mask bits per character
+      for (size_t k = 0; mask; k++, mask >>= 2)
+        if ((mask & 1) && MatchesPrefix(line, i + k, prefix))
+          return true;
+    }
+  }
+#endif
+
+  for (; i + prefix.size() <= line.size(); i++)
+    if (line[i] == prefix[0] && MatchesPrefix(line, i, prefix))
+      return true;
+  return false;
+}
+
 // ------------------------------------------------------------------------- //
 #endif  // GET_ARGUMENTS_H
-
@@ -0,0 +1,202 @@
+// ------------------------------------------------------------------------- //
+// Launch Journal                                                            //
+// ------------------------------------------------------------------------- //
+/**@file    JOURNAL.H
+ * @brief   Shared ring buffer recording every shim launch
+ * @date    10/16/2026
+ *
+ * -------------------------------------------------------------------------
+ * Every shim with a journal directory appends one fixed-size record to
+ * DIR\shim_journal.bin, a file mapped by all shims at once. A writer takes a
+ * slot with one interlocked increment of the header's counter, fills in the
+ * record and stores its sequence number last; a reader only trusts records
+ * whose sequence matches before and after copying. Once the ring is full the
+ * oldest records are overwritten. Nothing here ever waits on a lock, and any
+ * failure (no directory, no access, a foreign file) quietly drops the record.
+ *
+ *  JournalAppend
+ *      writes a record to the journal in a directory
+ *
+ *  JournalRead
+ *      copies the complete records of a journal, oldest first
+ *
+ * -------------------------------------------------------------------------
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ * ------------------------------------------------------------------------- */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+// ------------------------------------------------------------------------- //
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#define JOURNAL_FILE      L"shim_journal.bin"
+#define JOURNAL_MAGIC     0x4C4E524A4D494853ULL       // "SHIMJRNL"
+#define JOURNAL_VERSION   1
+#define JOURNAL_SLOTS     16384                       // 2 MB of records
+#define JOURNAL_NAME      40
+
+// Record flags
+#define JOURNAL_WAITED    0x1     // duration covers the whole run
+#define JOURNAL_FAILED    0x2     // target could not be started
+#define JOURNAL_TIMED_OUT 0x4     // terminated by --shim-Timeout
+
+using namespace std;
+
+struct JournalHeader {
+  ULONGLONG         magic;
+  DWORD             version;
+  DWORD             slots;
+  volatile LONGLONG next;         // total records ever written
+  BYTE              reserved[40];
+};
+
+struct JournalRecord {
+  volatile LONGLONG sequence;     // slot + 1, stored last; 0 while writing
+  ULONGLONG         timestamp;    // FILETIME (UTC) of the launch
+  ULONGLONG         shimId;       // FNV-1a of the shim's full path
+  ULONGLONG         duration;     // target run time, microseconds
+  DWORD             overhead;     // shim start until target resumed, us
+  DWORD             exitCode;
+  DWORD             processId;
+  DWORD             flags;
+  wchar_t           name[JOURNAL_NAME];   // shim file name, truncated
+};
+
+static_assert(sizeof(JournalHeader) == 64, "journal header size");
+static_assert(sizeof(JournalRecord) == 128, "journal record size");
+
+#define JOURNAL_BYTES \
+  (sizeof(JournalHeader) + (ULONGLONG)JOURNAL_SLOTS * sizeof(JournalRecord))
+
+
+// Identity of a shim: FNV-1a of its upper cased path
+ULONGLONG JournalShimId(wstring path) {
+  ULONGLONG hash = 0xCBF29CE484222325ULL;
+  for (wchar_t c : path) {
+    hash ^= (ULONGLONG)towupper(c);
+    hash *= 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+
+// Maps the journal in DIRECTORY, creating it if needed. Returns the view, or
+// nullptr if it is unavailable for any reason.
+JournalHeader *JournalMap(const wstring &directory, bool create) {
+  wstring path = directory + L"\\" JOURNAL_FILE;
+  HANDLE file = CreateFileW(
+      path.c_str(),
+      create ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+      nullptr, create ? OPEN_ALWAYS : OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return nullptr;
+
+  // Mapping a new (empty) file at full size grows it with zeros
+  HANDLE mapping = CreateFileMappingW(
+      file, nullptr, create ? PAGE_READWRITE : PAGE_READONLY,
+      (DWORD)(JOURNAL_BYTES >> 32), (DWORD)JOURNAL_BYTES, nullptr);
+  CloseHandle(file);
+  if (!mapping)
+    return nullptr;
+
+  JournalHeader *header = (JournalHeader *)MapViewOfFile(
+      mapping, create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, JOURNAL_BYTES);
+  CloseHandle(mapping);
+  if (!header)
+    return nullptr;
+
+  // Whoever gets here first stamps the header; the fields are constants so
+  // racing writers agree on them
+  if (create && header->magic == 0) {
+    header->version = JOURNAL_VERSION;
+    header->slots   = JOURNAL_SLOTS;
+    InterlockedCompareExchange64(
+      (volatile LONGLONG *)&header->magic, (LONGLONG)JOURNAL_MAGIC, 0);
+  }
+
+  if (header->magic != JOURNAL_MAGIC ||
+      header->version != JOURNAL_VERSION ||
+      header->slots != JOURNAL_SLOTS) {
+    UnmapViewOfFile(header);
+    return nullptr;
+  }
+  return header;
+}
+
+
+/**@brief  Writes a record to the journal
+ *
+ * @param  DIRECTORY: where the journal lives (not created)
+ * @param  RECORD:    the record, its sequence is filled in here
+ */
+void JournalAppend(const wstring &directory, JournalRecord record) {
+  JournalHeader *header = JournalMap(directory, true);
+  if (!header)
+    return;
+
+  JournalRecord *records = (JournalRecord *)(header + 1);
+  LONGLONG sequence = InterlockedIncrement64(&header->next);
+  JournalRecord *slot = &records[(sequence - 1) % JOURNAL_SLOTS];
+
+  // Invalidate the slot, fill it in, then publish it
+  InterlockedExchange64(&slot->sequence, 0);
+  record.sequence = 0;
+  *slot = record;
+  InterlockedExchange64(&slot->sequence, sequence);
+
+  UnmapViewOfFile(header);
+}
+
+
+/**@brief  Copies the complete records of a journal
+ *
+ * @param  DIRECTORY: where the journal lives
+ * @param  RECORDS:   receives the records, oldest first
+ *
+ * @return FALSE if there is no usable journal
+ */
+bool JournalRead(const wstring &directory, vector<JournalRecord> &records) {
+  JournalHeader *header = JournalMap(directory, false);
+  if (!header)
+    return false;
+
+  const JournalRecord *slots = (const JournalRecord *)(header + 1);
+  LONGLONG next = header->next;
+  LONGLONG first = max<LONGLONG>(next - JOURNAL_SLOTS, 0) + 1;
+
+  records.clear();
+  for (LONGLONG sequence = first; sequence <= next; sequence++) {
+    const JournalRecord *slot = &slots[(sequence - 1) % JOURNAL_SLOTS];
+
+    // Skip records still being written or already overwritten
+    if (slot->sequence != sequence)
+      continue;
+    JournalRecord copy = *slot;
+    MemoryBarrier();
+    if (slot->sequence == sequence && copy.sequence == sequence)
+      records.push_back(copy);
+  }
+
+  UnmapViewOfFile(header);
+  return true;
+}
+
+// ------------------------------------------------------------------------- //
+#endif  // JOURNAL_H
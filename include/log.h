@@ -21,6 +21,12 @@
  *  - automatic conversion of FILESYSTEM::PATH objects
  *  - automatic conversion of BOOL
  *  - automatic attaching to console or stream to file
+ *  - file output kept in memory and appended as one record (tagged with
+ *    time and PID) by LogFlush or at exit, so concurrent processes never
+ *    interleave; the file is rotated by size and falls back to
+ *    %LOCALAPPDATA% or %TEMP% when it cannot be written where it is. A shim
+ *    that waits for its target flushes before the wait, so one launch
+ *    writes two records with the same PID: startup, then the exit.
  *
  *
  * ------------------------------------------------------------------------- 
@@ -41,11 +47,14 @@
 #define LOG_H
 
 // ------------------------------------------------------------------------- //
+#include <windows.h>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
-#include <shlwapi.h>
-#pragma comment(lib, "Shlwapi.lib")
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+#include <cwctype>
 
 
 using namespace std;
@@ -57,6 +66,9 @@ struct structlog {
   string    false_value =   "No";
   string    file_ext =      ".log";
   filesystem::path log_file;
+  ULONGLONG rotate_size =   1 << 20;    // bytes before the file is rotated
+  int       rotate_count =  3;          // rotated files kept (.1, .2, ...)
+  string    pending;                    // file output not yet written
 };
 
 structlog LOGCFG;
@@ -118,6 +130,11 @@ public:
       return printString(msg ? LOGCFG.true_value : LOGCFG.false_value);
     }
 
+    // Number
+    if constexpr ( is_arithmetic_v<T> ) {
+      return printString(to_string(msg));
+    }
+
     return printString("[could not output variable]");
   }
   
@@ -142,7 +159,10 @@ private:
 
   // ---------- Print String ---------- // 
   LOG &printString(const string msg) {
-    cerr << msg;
+    if (stream_type == 3)
+      LOGCFG.pending += msg;
+    else
+      cerr << msg;
     return *this;
   }
   
@@ -174,10 +194,11 @@ private:
       stream << endl;        // don't remember why
     }
     else if(GetLastError() == ERROR_INVALID_HANDLE) {
+      // Collected in LOGCFG.PENDING until LogFlush
       stream_type = 3;
       if (LOGCFG.log_file.empty())
         setLogFile();
-      stream.open(LOGCFG.log_file, ios::out | ios::app);
+      return;
     }
     else 
       return;
@@ -212,8 +233,6 @@ private:
     
       FreeConsole();
     }
-    else if(stream_type == 3) 
-      stream.close();
 
     stream_type = 0;
   }
@@ -231,5 +250,131 @@ private:
   
 };
 
+
+// ------------------------------- Log File -------------------------------- //
+// Whether appending RECORD bytes would take FILE over the size cap (an empty
+// file never is, however large the record)
+bool LogFull(const filesystem::path &file, size_t record) {
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (!LOGCFG.rotate_size ||
+      !GetFileAttributesExW(file.c_str(), GetFileExInfoStandard, &data))
+    return false;
+  ULONGLONG size = ((ULONGLONG)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+  return size && size + record > LOGCFG.rotate_size;
+}
+
+// FNV-1a of PATH, case insensitive like the file system
+ULONGLONG LogHash(const filesystem::path &path) {
+  ULONGLONG hash = 0xCBF29CE484222325ULL;
+  for (wchar_t c : path.wstring()) {
+    hash ^= towupper(c);
+    hash *= 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+// Shifts FILE to FILE.1, FILE.1 to FILE.2 and so on, dropping the oldest.
+// One process rotates at a time and nobody waits for it: while another one
+// is at it, or a file is in use, the record just goes into the current file.
+void LogRotate(const filesystem::path &file, size_t record) {
+  wchar_t name[64];
+  swprintf(name, 64, L"Local\\shim_log_%016llx", LogHash(file));
+
+  HANDLE mutex = CreateMutexW(nullptr, FALSE, name);
+  if (!mutex)
+    return;
+  DWORD wait = WaitForSingleObject(mutex, 0);
+  if (wait == WAIT_OBJECT_0 || wait == WAIT_ABANDONED) {
+    // Someone may have rotated it in the meantime
+    if (LogFull(file, record)) {
+      auto rotated = [&](int i) {
+        return i ? file.wstring() + L"." + to_wstring(i) : file.wstring();
+      };
+      if (LOGCFG.rotate_count <= 0)
+        DeleteFileW(file.c_str());
+      for (int i = LOGCFG.rotate_count; i > 0; i--)
+        MoveFileExW(rotated(i - 1).c_str(), rotated(i).c_str(),
+                    MOVEFILE_REPLACE_EXISTING);
+    }
+    ReleaseMutex(mutex);
+  }
+  CloseHandle(mutex);
+}
+
+// Opens FILE for appending, rotating it first when it is over the size cap
+HANDLE LogOpen(const filesystem::path &file, size_t record) {
+  if (LogFull(file, record))
+    LogRotate(file, record);
+
+  // Appends of a single write never mix with those of other processes, and
+  // sharing delete lets others rotate the file meanwhile
+  return CreateFileW(file.c_str(), FILE_APPEND_DATA,
+                     FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                     nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+}
+
+// Appends RECORD to FILE in a single write
+bool LogWrite(const filesystem::path &file, const string &record) {
+  HANDLE handle = LogOpen(file, record.size());
+  if (handle == INVALID_HANDLE_VALUE)
+    return false;
+  DWORD written = 0;
+  bool ok = WriteFile(handle, record.data(), (DWORD)record.size(),
+                      &written, nullptr) && written == record.size();
+  CloseHandle(handle);
+  return ok;
+}
+
+// Writes the file output collected so far as one record: next to the
+// program if possible, else in %LOCALAPPDATA%\shim_executable or %TEMP%.
+// The fallback is only looked up (and created) once the program's own
+// directory refused the file, and is named with a hash of that directory
+// too, so shims of the same name in different places keep separate logs.
+void LogFlush() {
+  if (LOGCFG.pending.empty())
+    return;
+
+  SYSTEMTIME now;
+  GetLocalTime(&now);
+  char header[96];
+  snprintf(header, sizeof(header),
+           "==== %04u-%02u-%02u %02u:%02u:%02u.%03u  PID %lu ====\n",
+           now.wYear, now.wMonth, now.wDay, now.wHour, now.wMinute,
+           now.wSecond, now.wMilliseconds,
+           (unsigned long)GetCurrentProcessId());
+  string record = header + LOGCFG.pending;
+  if (record.back() != '\n')
+    record += '\n';
+
+  if (!LogWrite(LOGCFG.log_file, record)) {
+    struct { const wchar_t *variable; const wchar_t *subdirectory; }
+    fallbacks[] = {{L"LOCALAPPDATA", L"shim_executable"}, {L"TEMP", L""}};
+
+    wchar_t hash[16];
+    swprintf(hash, 16, L"-%08llx",
+             LogHash(LOGCFG.log_file.parent_path()) & 0xFFFFFFFF);
+    filesystem::path name = LOGCFG.log_file.stem();
+    name += hash;
+    name += LOGCFG.log_file.extension();
+
+    for (const auto &fallback : fallbacks) {
+      const wchar_t *directory = _wgetenv(fallback.variable);
+      if (!directory || !*directory)
+        continue;
+      filesystem::path path =
+        filesystem::path(directory) / fallback.subdirectory;
+      CreateDirectoryW(path.c_str(), nullptr);
+      if (LogWrite(path / name, record))
+        break;
+    }
+  }
+  string().swap(LOGCFG.pending);
+}
+
+// Whatever is left is written when the program exits
+struct LogFlushAtExit {
+  ~LogFlushAtExit() { LogFlush(); }
+} LOGFLUSH;
+
 // ------------------------------------------------------------------------- //
 #endif // LOG_H
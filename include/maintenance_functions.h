@@ -0,0 +1,688 @@
+// ------------------------------------------------------------------------- //
+// Maintenance of Existing Shims                                             //
+// ------------------------------------------------------------------------- //
+/**@file    MAINTENANCE_FUNCTIONS.H
+ * @brief   Methods for auditing shims that were already created
+ * @date    10/16/2026
+ *
+ * -------------------------------------------------------------------------
+ * Defines the following:
+ *
+ *  ReadShimInfo
+ *      reads the settings of a shim from its resources and its sidecar (see
+ *      SIDECAR.H), without running it
+ *
+ *  CollectShims / ParallelFor
+ *      list the executables in files and directory trees, and spread work on
+ *      them over one thread per core
+ *
+ *  InspectShims
+ *      audits every shim in a list of files and directory trees on a pool of
+ *      threads, classifying each as valid, stale or broken, and writes a
+ *      JSON report. Broken shims can be deleted (pruned).
+ *
+ *  RetargetShims
+ *      rewrites the target and working directory paths of shims under an old
+ *      prefix to a new one. Values that fit the space reserved for them
+ *      (RESOURCE_PATH_RESERVE) are patched in place, with the checksum
+ *      updated, otherwise the resources are rebuilt once. Each shim is
+ *      patched as a copy that then replaces it, so a shim is never left half
+ *      written. Shims with a sidecar keep their executable as it is; the
+ *      path lines of the sidecar are rewritten instead.
+ *
+ *  UpgradeShims
+ *      re-wraps shims stamped with an older template build ID (or none) in
+ *      the current template of the same architecture, carrying over their
+ *      settings, icons and version info. The resources are rebuilt in memory
+ *      like the builder does, so a shim always upgrades to the same bytes
+ *      with a valid checksum. Replaced the same way as when retargeting.
+ *
+ * -------------------------------------------------------------------------
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ * ------------------------------------------------------------------------- */
+
+#ifndef MAINTENANCE_FUNCTIONS_H
+#define MAINTENANCE_FUNCTIONS_H
+
+// ------------------------------------------------------------------------- //
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <map>
+#include <log.h>
+#include <resource_functions.h>
+#include <utility_functions.h>
+#include <pe_machine.h>
+#include <pe_resources.h>
+#include <template_store.h>
+#include <script_functions.h>
+#include <sidecar.h>
+
+using namespace std;
+
+struct ShimInfo {
+  filesystem::path  shim;
+  wstring           target;
+  wstring           args;
+  wstring           type;
+  wstring           wdType;
+  wstring           wdPath;
+  wstring           interpreter;        // command line, scripts only
+  wstring           templateId;         // empty for shims made before IDs
+  filesystem::path  sidecar;            // empty if it has none
+  bool              isShim  = false;
+  string            status;             // valid, stale or broken
+  string            reason;
+  bool              pruned  = false;
+};
+
+
+// --------------------------- Read Shim Settings -------------------------- //
+/**@brief  Reads the settings of a shim, those of its sidecar first
+ *
+ * @param  SHIM:  path of the executable
+ * @param  INFO:  receives the settings; isShim is FALSE if SHIM is not one
+ *
+ * @return FALSE if the file could not be opened
+ */
+bool ReadShimInfo(const filesystem::path &shim, ShimInfo &info) {
+  info.shim = shim;
+
+  HMODULE module =
+    LoadLibraryExW(shim.c_str(), NULL, LOAD_LIBRARY_AS_DATAFILE);
+  if (!module)
+    return false;
+
+  // Every shim SHIM_EXEC builds carries these, also when its sidecar has the
+  // settings; an executable without them (e.g. one of Scoop's shims, which
+  // reads a sidecar of the same name) is not one of ours
+  info.isShim = GetResourceData(module, "SHIM_PATH", info.target) &&
+                GetResourceData(module, "SHIM_TYPE", info.type);
+  if (info.isShim) {
+    GetResourceData(module, "SHIM_ARGS", info.args);
+    GetResourceData(module, "WD_TYPE", info.wdType);
+    GetResourceData(module, "WD_PATH", info.wdPath);
+    GetResourceData(module, "SHIM_INTERPRETER", info.interpreter);
+    GetResourceData(module, "SHIM_TEMPLATE", info.templateId);
+  }
+  FreeLibrary(module);
+  if (!info.isShim)
+    return true;
+
+  map<string, wstring> sidecar;
+  if (ReadSidecar(SidecarPath(shim), sidecar)) {
+    info.sidecar = SidecarPath(shim);
+    struct { LPCSTR name; wstring &value; } settings[] = {
+      {"SHIM_PATH", info.target}, {"SHIM_ARGS", info.args},
+      {"WD_TYPE", info.wdType},   {"WD_PATH", info.wdPath},
+      {"SHIM_INTERPRETER", info.interpreter},
+    };
+    for (auto &setting : settings) {
+      auto found = sidecar.find(setting.name);
+      if (found != sidecar.end())
+        setting.value = found->second;
+    }
+    UpperCase(info.wdType);
+  }
+  return true;
+}
+
+
+// Whether the program of an interpreter command line can be found the way
+// CreateProcess looks for it: as given, else on the search path
+bool InterpreterExists(const ShimInfo &info) {
+  wstring program, args;
+  InterpreterCommand(info.interpreter, info.target, L"", program, args);
+  return !program.empty() &&
+    SearchPathW(NULL, program.c_str(), L".exe", 0, NULL, NULL) != 0;
+}
+
+// Sets the status of a shim: broken if it cannot run at all, stale if it runs
+// but was built against an older state of things
+void ClassifyShim(ShimInfo &info) {
+  WIN32_FILE_ATTRIBUTE_DATA shimData    = {};
+  WIN32_FILE_ATTRIBUTE_DATA targetData  = {};
+  error_code                ec;
+  GetFileAttributesExW(info.shim.c_str(), GetFileExInfoStandard, &shimData);
+
+  // A sidecar changes the shim as much as rewriting it would
+  WIN32_FILE_ATTRIBUTE_DATA sidecarData = {};
+  if (!info.sidecar.empty() &&
+      GetFileAttributesExW(info.sidecar.c_str(), GetFileExInfoStandard,
+                           &sidecarData) &&
+      CompareFileTime(&sidecarData.ftLastWriteTime,
+                      &shimData.ftLastWriteTime) > 0)
+    shimData.ftLastWriteTime = sidecarData.ftLastWriteTime;
+
+  info.status = "broken";
+  if (info.target.empty())
+    info.reason = "no target";
+  else if (!GetFileAttributesExW(info.target.c_str(), GetFileExInfoStandard,
+                                 &targetData))
+    info.reason = "target does not exist";
+  else if (targetData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+    info.reason = "target is a directory";
+  else if (filesystem::equivalent(info.shim, info.target, ec))
+    info.reason = "shim points to itself";
+  else if (!info.interpreter.empty() && !InterpreterExists(info))
+    info.reason = "interpreter does not exist";
+  else {
+    info.status = "stale";
+    if (info.wdType == L"PATH" && !info.wdPath.empty() &&
+        GetFileAttributesW(info.wdPath.c_str()) == INVALID_FILE_ATTRIBUTES)
+      info.reason = "working directory does not exist";
+    else if (CompareFileTime(&targetData.ftLastWriteTime,
+                             &shimData.ftLastWriteTime) > 0)
+      info.reason = "target changed after the shim was created";
+    else
+      info.status = "valid";
+  }
+}
+
+
+// ------------------------------ Shim Lists ------------------------------- //
+// Executables among PATHS, searching directories recursively
+vector<filesystem::path> CollectShims(const vector<wstring> &paths) {
+  vector<filesystem::path> files;
+  for (const wstring &path : paths) {
+    error_code ec;
+    if (filesystem::is_directory(path, ec)) {
+      filesystem::recursive_directory_iterator iter(
+          path, filesystem::directory_options::skip_permission_denied, ec);
+      for (; iter != filesystem::recursive_directory_iterator();
+           iter.increment(ec)) {
+        wstring extension = iter->path().extension().wstring();
+        UpperCase(extension);
+        if (extension == L".EXE" && iter->is_regular_file(ec))
+          files.push_back(iter->path());
+      }
+    }
+    else if (filesystem::exists(path, ec))
+      files.push_back(path);
+    else
+      LOG(2) << "Not found, skipping: '" << path << "'";
+  }
+  return files;
+}
+
+// Calls WORK(i) for every i below COUNT on one thread per core
+template <class Work>
+void ParallelFor(size_t count, Work work) {
+  atomic<size_t> next = 0;
+  auto worker = [&]() {
+    for (size_t i = next++; i < count; i = next++)
+      work(i);
+  };
+
+  unsigned threads = max(1u, thread::hardware_concurrency());
+  threads = (unsigned)min<size_t>(threads, max<size_t>(count, 1));
+  vector<thread> pool;
+  for (unsigned i = 1; i < threads; i++)
+    pool.emplace_back(worker);
+  worker();
+  for (thread &t : pool)
+    t.join();
+}
+
+
+// ------------------------------ Inspection ------------------------------- //
+void ShimInfoJson(ostream &json, const ShimInfo &info) {
+  json << "\n    {\"shim\": " << JsonString(info.shim.wstring())
+       << ", \"target\": " << JsonString(info.target)
+       << ", \"args\": " << JsonString(info.args)
+       << ", \"type\": " << JsonString(info.type)
+       << ", \"wd_type\": " << JsonString(info.wdType)
+       << ", \"wd_path\": " << JsonString(info.wdPath)
+       << ", \"template\": " << JsonString(info.templateId);
+  if (!info.interpreter.empty())
+    json << ", \"interpreter\": " << JsonString(info.interpreter);
+  if (!info.sidecar.empty())
+    json << ", \"sidecar\": " << JsonString(info.sidecar.wstring());
+  if (!info.reason.empty())
+    json << ", \"reason\": \"" << info.reason << "\"";
+  if (info.pruned)
+    json << ", \"pruned\": true";
+  json << "}";
+}
+
+/**@brief  Audits shims
+ *
+ * @param  PATHS:   shims and directories (searched recursively for *.exe)
+ * @param  PRUNE:   delete the broken shims
+ * @param  REPORT:  file for the JSON report, stdout if empty
+ *
+ * @return 0 if no broken shims are left, otherwise 1
+ */
+int InspectShims(const vector<wstring> &paths, bool prune,
+                 const wstring &report) {
+  vector<filesystem::path> files = CollectShims(paths);
+  vector<ShimInfo> results(files.size());
+
+  ParallelFor(files.size(), [&](size_t i) {
+    ShimInfo &info = results[i];
+    if (!ReadShimInfo(files[i], info) || !info.isShim)
+      return;
+
+    ClassifyShim(info);
+    if (prune && info.status == "broken") {
+      info.pruned = DeleteFileW(info.shim.c_str()) != 0;
+      if (info.pruned && !info.sidecar.empty())
+        DeleteFileW(info.sidecar.c_str());
+    }
+  });
+
+  // ---------- Report ---------- //
+  size_t shims = 0, left = 0;
+  ostringstream sections[3];
+  size_t counts[3] = {};
+  const char *names[3] = {"valid", "stale", "broken"};
+
+  for (const ShimInfo &info : results) {
+    if (!info.isShim)
+      continue;
+    shims++;
+    for (int s = 0; s < 3; s++) {
+      if (info.status == names[s]) {
+        sections[s] << (counts[s]++ ? "," : "");
+        ShimInfoJson(sections[s], info);
+      }
+    }
+    if (info.status == "broken" && !info.pruned)
+      left++;
+  }
+
+  ostringstream json;
+  json << "{\n  \"scanned\": " << files.size()
+       << ",\n  \"shims\": " << shims;
+  for (int s = 0; s < 3; s++)
+    json << ",\n  \"" << names[s] << "_count\": " << counts[s];
+  for (int s = 0; s < 3; s++)
+    json << ",\n  \"" << names[s] << "\": [" << sections[s].str()
+         << (counts[s] ? "\n  ]" : "]");
+  json << "\n}\n";
+
+  if (report.empty())
+    cout << json.str();
+  else if (!(ofstream(filesystem::path(report)) << json.str())) {
+    LOG(1) << "Could not write report to '" << report << "'";
+    return 1;
+  }
+
+  return left ? 1 : 0;
+}
+
+
+// ----------------------------- Retargeting ------------------------------- //
+// A path resource of a shim and where its data sits in the file
+struct ResourceSlot {
+  LPCSTR    name;
+  wstring   value;
+  wstring   update;                     // new value, empty if unchanged
+  ULONGLONG offset    = 0;
+  DWORD     bytes     = 0;
+  bool      found     = false;
+
+  // Only shims that already reserve space know to ignore the padding; older
+  // ones would pass the NULs on as part of the path
+  bool padded() const {
+    return bytes / sizeof(wchar_t) > value.size();
+  }
+
+  bool fits() const {
+    size_t reserved = bytes / sizeof(wchar_t);
+    return update.size() == reserved ||
+      (padded() && update.size() <= reserved);
+  }
+};
+
+// A module loaded with LOAD_LIBRARY_AS_DATAFILE is a flat view of the file,
+// so the offset of the data within the view is its offset in the file
+void ReadResourceSlot(HMODULE module, ResourceSlot &slot) {
+  HRSRC resource = FindResource(module, slot.name, RT_RCDATA);
+  if (!resource)
+    return;
+
+  BYTE *base  = (BYTE *)((ULONG_PTR)module & ~(ULONG_PTR)3);
+  BYTE *data  = (BYTE *)LockResource(LoadResource(module, resource));
+  slot.bytes  = SizeofResource(module, resource);
+  slot.offset = data - base;
+  slot.value  = wstring((LPCWSTR)data,
+                        wcsnlen((LPCWSTR)data, slot.bytes / sizeof(wchar_t)));
+  slot.found  = true;
+}
+
+// Replaces OLDPREFIX in VALUE, only at a path boundary
+bool ReplacePrefix(const wstring &value, const wstring &oldPrefix,
+                   const wstring &newPrefix, wstring &output) {
+  if (value.size() < oldPrefix.size() ||
+      _wcsnicmp(value.c_str(), oldPrefix.c_str(), oldPrefix.size()) != 0)
+    return false;
+
+  wchar_t next = value.c_str()[oldPrefix.size()];
+  if (next != L'\0' && next != L'\\' && next != L'/' &&
+      oldPrefix.back() != L'\\' && oldPrefix.back() != L'/')
+    return false;
+
+  output = newPrefix + value.substr(oldPrefix.size());
+  return true;
+}
+
+/**@brief  Retargets one shim
+ *
+ * @return "patched", "rebuilt" or "sidecar" when done, "" if the shim does
+ *         not match, otherwise the reason it failed
+ */
+string RetargetShim(const filesystem::path &shim, const wstring &oldPrefix,
+                    const wstring &newPrefix) {
+  ResourceSlot slots[] = {{"SHIM_PATH"}, {"WD_PATH"}};
+
+  HMODULE module =
+    LoadLibraryExW(shim.c_str(), NULL, LOAD_LIBRARY_AS_DATAFILE);
+  if (!module)
+    return "";
+  for (ResourceSlot &slot : slots)
+    ReadResourceSlot(module, slot);
+  FreeLibrary(module);
+  if (!slots[0].found)
+    return "";
+
+  // A shim with a sidecar takes its paths from there, so only the sidecar is
+  // rewritten (with the embedded paths it did not set, where they change).
+  // Only the lines of the paths change; comments and other keys stay.
+  filesystem::path sidecarPath = SidecarPath(shim);
+  string text;
+  if (ReadSidecarText(sidecarPath, text)) {
+    map<string, wstring> sidecar, changes;
+    ParseSidecar(text, sidecar);
+    for (ResourceSlot &slot : slots) {
+      auto found = sidecar.find(slot.name);
+      const wstring &value = found != sidecar.end() ? found->second :
+                             slot.value;
+      wstring update;
+      if (ReplacePrefix(value, oldPrefix, newPrefix, update))
+        changes[slot.name] = update;
+    }
+    if (changes.empty())
+      return "";
+
+    string output;
+    if (!RewriteSidecar(text, changes, output))
+      return "new path has a line break";
+    return WriteSidecarText(sidecarPath, output) ? "sidecar"
+                                                 : "could not write sidecar";
+  }
+
+  bool changed = false, inPlace = true;
+  for (ResourceSlot &slot : slots) {
+    if (slot.found &&
+        ReplacePrefix(slot.value, oldPrefix, newPrefix, slot.update)) {
+      changed = true;
+      inPlace = inPlace && slot.fits();
+    }
+  }
+  if (!changed)
+    return "";
+
+  // Patched or rebuilt in memory, so the checksum is brought up to date
+  // before the copy next to the shim is written and swapped in
+  vector<BYTE> image;
+  if (!ReadFileData(shim, image))
+    return "could not read shim";
+
+  bool written = true;
+  if (inPlace) {
+    for (ResourceSlot &slot : slots) {
+      if (!written || slot.update.empty())
+        continue;
+
+      wstring data = slot.update;
+      data.resize(slot.bytes / sizeof(wchar_t), L'\0');
+      written = slot.offset + slot.bytes <= image.size();
+      if (written)
+        memcpy(image.data() + slot.offset, data.c_str(),
+               data.size() * sizeof(wchar_t));
+    }
+
+    PeImage pe;
+    written = written && PeParse(image.data(), image.size(), pe);
+    if (written)
+      *pe.checkSum = PeChecksum(image.data(), image.size(),
+                                (BYTE *)pe.checkSum - image.data());
+  }
+  else {
+    vector<PeResource> resources;
+    written = PeReadResources(image.data(), image.size(), resources);
+    for (ResourceSlot &slot : slots) {
+      if (!written || slot.update.empty())
+        continue;
+
+      wstring data = slot.update;
+      if (slot.padded() && data.size() < RESOURCE_PATH_RESERVE)
+        data.resize(RESOURCE_PATH_RESERVE, L'\0');
+
+      PeResource resource;
+      resource.type     = PeKey((LPCWSTR)RT_RCDATA);
+      resource.name     = PeKey(WideString(slot.name).c_str());
+      resource.language = MAKELANGID(LANG_NEUTRAL, SUBLANG_NEUTRAL);
+      resource.data.assign((const BYTE *)data.data(),
+                           (const BYTE *)(data.data() + data.size()));
+      PeSetResource(resources, move(resource));
+    }
+    written = written && PeWriteResources(image, resources);
+  }
+
+  filesystem::path temp = shim;
+  temp += L".retarget";
+  written = written && WriteFileData(temp, image);
+  if (!written ||
+      !MoveFileExW(temp.c_str(), shim.c_str(),
+                   MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+    DeleteFileW(temp.c_str());
+    return written ? "could not replace shim (in use?)"
+                   : "could not update copy";
+  }
+  return inPlace ? "patched" : "rebuilt";
+}
+
+/**@brief  Retargets every matching shim
+ *
+ * @param  OLDPREFIX: target prefix to replace (case insensitive)
+ * @param  NEWPREFIX: its replacement
+ * @param  PATHS:     shims and directories (searched recursively for *.exe)
+ *
+ * @return 0 if every matching shim was retargeted, otherwise 1
+ */
+int RetargetShims(const wstring &oldPrefix, const wstring &newPrefix,
+                  const vector<wstring> &paths) {
+  vector<filesystem::path> files = CollectShims(paths);
+  vector<string> results(files.size());
+
+  ParallelFor(files.size(), [&](size_t i) {
+    results[i] = RetargetShim(files[i], oldPrefix, newPrefix);
+  });
+
+  size_t patched = 0, rebuilt = 0, sidecars = 0, failed = 0;
+  for (size_t i = 0; i < files.size(); i++) {
+    if (results[i].empty())
+      continue;
+    if (results[i] == "patched")
+      patched++;
+    else if (results[i] == "rebuilt")
+      rebuilt++;
+    else if (results[i] == "sidecar")
+      sidecars++;
+    else {
+      failed++;
+      LOG(1) << files[i] << ": " << results[i];
+      continue;
+    }
+    cout << results[i] << "  " << NarrowString(files[i].wstring()) << endl;
+  }
+
+  cout << patched + rebuilt + sidecars << " shims retargeted (" << patched
+       << " in place, " << rebuilt << " rebuilt, " << sidecars
+       << " by their sidecar), " << failed << " failed" << endl;
+  return failed ? 1 : 0;
+}
+
+
+// ------------------------------- Upgrading ------------------------------- //
+struct ShimUpgrade {
+  ShimInfo  info;
+  wstring   templateId;                 // what it was upgraded to
+  string    result;                     // upgraded, current or the error
+};
+
+// Template for shims of TYPE and MACHINE, picked as the builder does:
+// SHIM_<TYPE>_<ARCH> if one was built for MACHINE, else SHIM_<TYPE>
+string TemplateName(const wstring &type, uint16_t machine) {
+  string name = "SHIM_" + NarrowString(type);
+  if (const wchar_t *arch = PeMachineName(machine)) {
+    string specific = name + "_" + NarrowString(arch);
+    if (TemplateImage(NULL, specific))
+      return specific;
+  }
+  return name;
+}
+
+/**@brief  Upgrades every shim built from an older template
+ *
+ * @param  PATHS:   shims and directories (searched recursively for *.exe)
+ *
+ * @return 0 if every outdated shim was upgraded, otherwise 1
+ */
+int UpgradeShims(const vector<wstring> &paths) {
+  // Current template and its build ID per type and architecture, computed
+  // once (machine 0 for shims of an architecture without templates)
+  map<pair<wstring, uint16_t>, pair<string, wstring>> current;
+  for (const wchar_t *type : {L"CONSOLE", L"GUI"})
+    for (uint16_t machine : {0, PE_MACHINE_X86, PE_MACHINE_X64,
+                             PE_MACHINE_ARM64}) {
+      string name = TemplateName(type, machine);
+      current[{type, machine}] = {name, TemplateId(name)};
+    }
+
+  vector<filesystem::path> files = CollectShims(paths);
+  vector<ShimUpgrade> results(files.size());
+
+  ParallelFor(files.size(), [&](size_t i) {
+    ShimUpgrade &upgrade = results[i];
+    ShimInfo &info = upgrade.info;
+    if (!ReadShimInfo(files[i], info) || !info.isShim)
+      return;
+
+    wstring type = info.type;
+    UpperCase(type);
+    vector<BYTE> image;
+    if (!ReadFileData(info.shim, image)) {
+      upgrade.result = "could not read shim";
+      return;
+    }
+    uint16_t machine = PeMachine(image.data(), image.size());
+    auto found = current.find({type, PeMachineName(machine) ? machine : 0});
+    if (found == current.end()) {
+      upgrade.result = "unknown shim type";
+      return;
+    }
+    const string &templateName = found->second.first;
+    upgrade.templateId = found->second.second;
+    if (info.templateId == upgrade.templateId) {
+      upgrade.result = "current";
+      return;
+    }
+
+    // Fresh template, then everything the old shim carried on top of it
+    auto fresh = TemplateImage(NULL, templateName);
+    vector<BYTE> shim;
+    vector<PeResource> resources, carried;
+    if (fresh)
+      shim = *fresh;
+    if (!fresh || !PeReadResources(shim.data(), shim.size(), resources)) {
+      upgrade.result = "could not unpack template";
+      return;
+    }
+    if (!PeReadResources(image.data(), image.size(), carried)) {
+      upgrade.result = "could not read resources";
+      return;
+    }
+    for (PeResource &resource : carried) {
+      WORD id = resource.type.id;
+      if (resource.type.name.empty() &&
+          (id == (WORD)(ULONG_PTR)RT_ICON ||
+           id == (WORD)(ULONG_PTR)RT_GROUP_ICON ||
+           id == (WORD)(ULONG_PTR)RT_VERSION ||
+           id == (WORD)(ULONG_PTR)RT_RCDATA))
+        PeSetResource(resources, move(resource));
+    }
+
+    PeResource stamp;
+    stamp.type      = PeKey((LPCWSTR)RT_RCDATA);
+    stamp.name      = PeKey(L"SHIM_TEMPLATE");
+    stamp.language  = MAKELANGID(LANG_NEUTRAL, SUBLANG_NEUTRAL);
+    stamp.data.assign((const BYTE *)upgrade.templateId.data(),
+                      (const BYTE *)(upgrade.templateId.data() +
+                                     upgrade.templateId.size()));
+    PeSetResource(resources, move(stamp));
+
+    filesystem::path temp = info.shim;
+    temp += L".upgrade";
+    if (!PeWriteResources(shim, resources))
+      upgrade.result = "template is not a usable image";
+    else if (!WriteFileData(temp, shim))
+      upgrade.result = "could not write upgraded shim";
+    else if (!MoveFileExW(temp.c_str(), info.shim.c_str(),
+                          MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+      upgrade.result = "could not replace shim (in use?)";
+    else {
+      upgrade.result = "upgraded";
+      return;
+    }
+    DeleteFileW(temp.c_str());
+  });
+
+  size_t upgraded = 0, up_to_date = 0, failed = 0;
+  map<wstring, size_t> from;
+  for (const ShimUpgrade &upgrade : results) {
+    const ShimInfo &info = upgrade.info;
+    if (upgrade.result.empty())
+      continue;
+    if (upgrade.result == "current")
+      up_to_date++;
+    else if (upgrade.result == "upgraded") {
+      upgraded++;
+      from[info.templateId.empty() ? L"none" : info.templateId]++;
+      cout << "upgraded  " << NarrowString(info.shim.wstring()) << "  ("
+           << NarrowString(info.templateId.empty() ? L"none" : info.templateId)
+           << " -> " << NarrowString(upgrade.templateId) << ")" << endl;
+    }
+    else {
+      failed++;
+      LOG(1) << info.shim << ": " << upgrade.result;
+    }
+  }
+
+  cout << upgraded << " shims upgraded, " << up_to_date
+       << " already current, " << failed << " failed" << endl;
+  for (auto &[id, count] : from)
+    cout << "  " << count << " from template " << NarrowString(id) << endl;
+  return failed ? 1 : 0;
+}
+
+// ------------------------------------------------------------------------- //
+#endif  // MAINTENANCE_FUNCTIONS_H
@@ -0,0 +1,184 @@
+// ------------------------------------------------------------------------- //
+// Template Architecture                                                     //
+// ------------------------------------------------------------------------- //
+/**@file    PE_MACHINE.H
+ * @brief   Picks the architecture of the shim template for a target
+ * @date    10/16/2026
+ *
+ * -------------------------------------------------------------------------
+ * A shim of another architecture than the computer's runs emulated (x64 and
+ * x86 on ARM64) or under WOW64, which adds to every launch before the target
+ * even starts. Templates are built for x86, x64 and ARM64, and a shim gets
+ * the one matching its target: the target can only run where that
+ * architecture does, so the shim can too. Scripts, images of other
+ * architectures and AnyCPU .NET images (x86 in the header, but IL only and
+ * run natively by the CLR) get the computer's own.
+ *
+ * Defines the following:
+ *
+ *  PeMachine
+ *      the machine type in the file header of an image, 0 if it is not one
+ *      or runs on any
+ *
+ *  PeMachineName
+ *      X86, X64 or ARM64, as in the SHIM_<TYPE>_<ARCH> template resources
+ *
+ *  ShimMachine
+ *      the machine of the template for a target, following --arch
+ *
+ * Only the standard library is used, so this builds and can be checked on
+ * any platform.
+ *
+ * -------------------------------------------------------------------------
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ * ------------------------------------------------------------------------- */
+
+#ifndef PE_MACHINE_H
+#define PE_MACHINE_H
+
+// ------------------------------------------------------------------------- //
+#include <cstddef>
+#include <cstdint>
+#include <cwctype>
+#include <string>
+
+// IMAGE_FILE_MACHINE_* of the architectures templates are built for
+#define PE_MACHINE_X86      0x014C
+#define PE_MACHINE_X64      0x8664
+#define PE_MACHINE_ARM64    0xAA64
+
+// CLR header (IMAGE_COR20_HEADER) flags of a .NET image
+#define PE_COR_ILONLY           0x01
+#define PE_COR_32BITREQUIRED    0x02
+
+using namespace std;
+
+inline uint32_t PeRead(const uint8_t *data, size_t bytes) {
+  uint32_t value = 0;
+  for (size_t i = bytes; i-- > 0;)
+    value = value << 8 | data[i];
+  return value;
+}
+
+/**@brief  Whether a PE32 image is AnyCPU .NET: IL only and not marked as
+ *         needing 32 bits
+ *
+ * @param  IMAGE:   the file
+ * @param  SIZE:    its size in bytes
+ * @param  HEADER:  offset of its "PE\0\0" signature, the file header checked
+ *
+ * @return FALSE for native images and whenever a header is cut short
+ */
+inline bool PeAnyCpu(const uint8_t *image, size_t size, size_t header) {
+  if (size - header < 24)
+    return false;
+
+  // The optional header follows the 24 bytes of signature and file header,
+  // the section table (40 bytes a section) follows the optional header
+  size_t optional = header + 24;
+  size_t length   = PeRead(image + header + 20, 2);
+  size_t count    = PeRead(image + header + 6, 2);
+  size_t sections = optional + length;
+  if (length < 96 + 15 * 8 || sections > size ||
+      (size - sections) / 40 < count ||
+      PeRead(image + optional, 2) != 0x10B ||             // PE32
+      PeRead(image + optional + 92, 4) < 15)              // directories
+    return false;
+
+  // Data directory 14 is the CLR header; find the section holding it
+  uint32_t rva = PeRead(image + optional + 96 + 14 * 8, 4);
+  if (!rva)
+    return false;
+  for (size_t i = 0; i < count; i++) {
+    const uint8_t *section = image + sections + i * 40;
+    uint32_t address = PeRead(section + 12, 4);
+    uint32_t raw     = PeRead(section + 16, 4);
+    if (rva < address || rva - address >= raw)
+      continue;
+
+    size_t cor = (size_t)PeRead(section + 20, 4) + (rva - address);
+    if (cor > size || size - cor < 20)
+      return false;
+    uint32_t flags = PeRead(image + cor + 16, 4);
+    return (flags & PE_COR_ILONLY) && !(flags & PE_COR_32BITREQUIRED);
+  }
+  return false;
+}
+
+/**@brief  Machine type of an image
+ *
+ * @param  IMAGE: the file, or at least its headers (all of it for .NET)
+ * @param  SIZE:  its size in bytes
+ *
+ * @return IMAGE_FILE_MACHINE_* from the file header, 0 if IMAGE is not a PE
+ *         image (e.g. a script) or an AnyCPU .NET image, which runs on any
+ */
+inline uint16_t PeMachine(const uint8_t *image, size_t size) {
+  if (!image || size < 0x40 || image[0] != 'M' || image[1] != 'Z')
+    return 0;
+
+  // e_lfanew, then the signature and the file header's first field
+  size_t header = PeRead(image + 0x3C, 4);
+  if (header > size || size - header < 6 ||
+      PeRead(image + header, 4) != 0x00004550)          // "PE\0\0"
+    return 0;
+  uint16_t machine = (uint16_t)PeRead(image + header + 4, 2);
+  if (machine == PE_MACHINE_X86 && PeAnyCpu(image, size, header))
+    return 0;
+  return machine;
+}
+
+// Architecture name of MACHINE, nullptr if no template is built for it
+inline const wchar_t *PeMachineName(uint16_t machine) {
+  switch (machine) {
+    case PE_MACHINE_X86:    return L"X86";
+    case PE_MACHINE_X64:    return L"X64";
+    case PE_MACHINE_ARM64:  return L"ARM64";
+    default:                return nullptr;
+  }
+}
+
+
+/**@brief  Machine of the template to build a shim with
+ *
+ * @param  TARGET:  machine of the target (PeMachine), 0 for scripts and
+ *                  AnyCPU .NET images
+ * @param  HOST:    native machine of this computer
+ * @param  ARCH:    --arch: TARGET (also when empty), HOST, X86, X64 (AMD64)
+ *                  or ARM64, ignoring case
+ *
+ * @return a PE_MACHINE_*, or 0 if ARCH is none of the above
+ */
+inline uint16_t ShimMachine(uint16_t target, uint16_t host,
+                            const wstring &arch) {
+  wstring name = arch;
+  for (wchar_t &c : name)
+    c = towupper(c);
+
+  if (name == L"X86")
+    return PE_MACHINE_X86;
+  if (name == L"X64" || name == L"AMD64")
+    return PE_MACHINE_X64;
+  if (name == L"ARM64")
+    return PE_MACHINE_ARM64;
+  if (name != L"HOST" && name != L"TARGET" && !name.empty())
+    return 0;
+
+  if (name != L"HOST" && PeMachineName(target))
+    return target;
+  return PeMachineName(host) ? host : PE_MACHINE_X64;
+}
+
+// ------------------------------------------------------------------------- //
+#endif  // PE_MACHINE_H
@@ -0,0 +1,615 @@
+// ------------------------------------------------------------------------- //
+// PE Resources in Memory                                                    //
+// ------------------------------------------------------------------------- //
+/**@file    PE_RESOURCES.H
+ * @brief   Reads and rewrites the resources of an executable image in memory
+ * @date    10/16/2026
+ *
+ * -------------------------------------------------------------------------
+ * BeginUpdateResource only works on files, so building a shim with it takes
+ * a temporary file and a rewrite of it for every resource. These functions
+ * do the same on a byte buffer: the resource tree is read into a flat list,
+ * edited, and written back as a new resource section.
+ *
+ *  PeReadResources
+ *      lists the resources of an image (any bitness, bounds checked so it is
+ *      safe on arbitrary input)
+ *
+ *  PeSetResource
+ *      adds a resource to a list, replacing one with the same type, name and
+ *      language like UpdateResource does
+ *
+ *  PeWriteResources
+ *      replaces the resource section of an image with a list, leaving a
+ *      valid checksum
+ *
+ *  PeSetTimestamp
+ *      sets the link time of an image (file header and debug directory)
+ *
+ *  PeSubsystem
+ *      the subsystem an image was linked for, 0 if it is not an image
+ *
+ * Nothing here keeps state or logs, so any number of threads can work on
+ * their own images at once. Everything is inline, so the generator's
+ * maintenance commands can use it next to the builder library.
+ *
+ * -------------------------------------------------------------------------
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ * ------------------------------------------------------------------------- */
+
+#ifndef PE_RESOURCES_H
+#define PE_RESOURCES_H
+
+// ------------------------------------------------------------------------- //
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <cwctype>
+
+#define PE_RESOURCE_LEVELS  3         // type, name, language
+#define PE_RESOURCE_ALIGN   8         // of each resource's data
+#define PE_RESOURCE_LIMIT   65536     // entries read from one image
+#define PE_SUBDIRECTORY     0x80000000
+
+using namespace std;
+
+// A resource type or name: an integer ID, or a string when NAME is set
+struct PeResourceKey {
+  WORD      id = 0;
+  wstring   name;
+};
+
+struct PeResource {
+  PeResourceKey   type;
+  PeResourceKey   name;
+  WORD            language = 0;
+  vector<BYTE>    data;
+};
+
+// Key from what FindResource takes: MAKEINTRESOURCE(ID) or a string. Like the
+// resource compiler, string keys are stored upper cased.
+inline PeResourceKey PeKey(LPCWSTR key) {
+  PeResourceKey result;
+  if (IS_INTRESOURCE(key))
+    result.id = (WORD)(ULONG_PTR)key;
+  else {
+    result.name = key;
+    for (wchar_t &c : result.name)
+      c = towupper(c);
+  }
+  return result;
+}
+
+// Order of a resource directory: strings first (case-insensitive), then IDs
+inline int PeCompare(const PeResourceKey &a, const PeResourceKey &b) {
+  if (a.name.empty() != b.name.empty())
+    return a.name.empty() ? 1 : -1;
+  if (a.name.empty())
+    return (int)a.id - (int)b.id;
+
+  size_t length = min(a.name.size(), b.name.size());
+  for (size_t i = 0; i < length; i++) {
+    wint_t x = towupper(a.name[i]), y = towupper(b.name[i]);
+    if (x != y)
+      return x < y ? -1 : 1;
+  }
+  return (int)(a.name.size() > b.name.size()) -
+         (int)(a.name.size() < b.name.size());
+}
+
+inline bool PeResourceLess(const PeResource &a, const PeResource &b) {
+  if (int c = PeCompare(a.type, b.type)) return c < 0;
+  if (int c = PeCompare(a.name, b.name)) return c < 0;
+  return a.language < b.language;
+}
+
+
+// ----------------------------- Image Headers ----------------------------- //
+// Offsets are checked against the buffer before anything is read, so a
+// truncated or hostile image fails instead of reading past its end
+struct PeImage {
+  IMAGE_FILE_HEADER     *file             = nullptr;
+  IMAGE_SECTION_HEADER  *sections         = nullptr;
+  IMAGE_DATA_DIRECTORY  *directories      = nullptr;
+  DWORD                 directoryCount    = 0;
+  DWORD                 sectionAlignment  = 0;
+  DWORD                 fileAlignment     = 0;
+  DWORD                 *sizeOfImage      = nullptr;
+  DWORD                 *sizeOfData       = nullptr;  // initialized data
+  DWORD                 *checkSum         = nullptr;
+  WORD                  subsystem         = 0;
+};
+
+inline bool PeInRange(size_t size, ULONGLONG offset, ULONGLONG length) {
+  return offset <= size && length <= size - offset;
+}
+
+template <class Header>
+inline bool PeOptionalHeader(BYTE *optional, WORD optionalSize, PeImage &pe) {
+  Header *header = (Header *)optional;
+  size_t fixed = offsetof(Header, DataDirectory);
+  if (optionalSize < fixed)
+    return false;
+
+  pe.sectionAlignment = header->SectionAlignment;
+  pe.fileAlignment    = header->FileAlignment;
+  pe.sizeOfImage      = &header->SizeOfImage;
+  pe.sizeOfData       = &header->SizeOfInitializedData;
+  pe.checkSum         = &header->CheckSum;
+  pe.subsystem        = header->Subsystem;
+  pe.directories      = header->DataDirectory;
+  pe.directoryCount   = min<DWORD>(header->NumberOfRvaAndSizes,
+                                   (optionalSize - (DWORD)fixed) /
+                                   sizeof(IMAGE_DATA_DIRECTORY));
+  return pe.fileAlignment && pe.sectionAlignment;
+}
+
+inline bool PeParse(BYTE *image, size_t size, PeImage &pe) {
+  pe = PeImage();
+  if (!PeInRange(size, 0, sizeof(IMAGE_DOS_HEADER)))
+    return false;
+  IMAGE_DOS_HEADER *dos = (IMAGE_DOS_HEADER *)image;
+  if (dos->e_magic != IMAGE_DOS_SIGNATURE)
+    return false;
+
+  ULONGLONG nt = (ULONGLONG)(DWORD)dos->e_lfanew;
+  if (!PeInRange(size, nt, sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER)) ||
+      *(DWORD *)(image + nt) != IMAGE_NT_SIGNATURE)
+    return false;
+
+  pe.file = (IMAGE_FILE_HEADER *)(image + nt + sizeof(DWORD));
+  ULONGLONG optional = nt + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER);
+  WORD optionalSize  = pe.file->SizeOfOptionalHeader;
+  if (!PeInRange(size, optional, optionalSize) || optionalSize < sizeof(WORD))
+    return false;
+
+  WORD magic = *(WORD *)(image + optional);
+  bool parsed =
+    magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC ?
+      PeOptionalHeader<IMAGE_OPTIONAL_HEADER64>(image + optional,
+                                                optionalSize, pe) :
+    magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC ?
+      PeOptionalHeader<IMAGE_OPTIONAL_HEADER32>(image + optional,
+                                                optionalSize, pe) :
+    false;
+
+  ULONGLONG sections = optional + optionalSize;
+  if (!parsed ||
+      !PeInRange(size, sections, (ULONGLONG)pe.file->NumberOfSections *
+                                 sizeof(IMAGE_SECTION_HEADER)))
+    return false;
+  pe.sections = (IMAGE_SECTION_HEADER *)(image + sections);
+  return true;
+}
+
+// File offset of LENGTH bytes at RVA, if they are all backed by the file
+inline bool PeOffset(const PeImage &pe, size_t size, DWORD rva, DWORD length,
+                     size_t &offset) {
+  for (WORD i = 0; i < pe.file->NumberOfSections; i++) {
+    const IMAGE_SECTION_HEADER &section = pe.sections[i];
+    ULONGLONG start = section.VirtualAddress;
+    if (rva >= start && (ULONGLONG)rva + length <= start + section.SizeOfRawData &&
+        PeInRange(size, (ULONGLONG)section.PointerToRawData + (rva - start),
+                  length)) {
+      offset = section.PointerToRawData + (rva - start);
+      return true;
+    }
+  }
+  return false;
+}
+
+inline DWORD PeAlign(ULONGLONG value, DWORD alignment) {
+  return (DWORD)((value + alignment - 1) / alignment * alignment);
+}
+
+inline WORD PeSubsystem(const BYTE *image, size_t size) {
+  PeImage pe;
+  return PeParse((BYTE *)image, size, pe) ? pe.subsystem : 0;
+}
+
+// What CheckSumMappedFile computes: a folded 16-bit sum of the file, taking
+// the checksum field at offset FIELD as zero, plus the file size
+inline DWORD PeChecksum(const BYTE *image, size_t size, size_t field) {
+  ULONGLONG sum = 0;
+  for (size_t i = 0; i < size; i += 2) {
+    if (i >= field && i < field + sizeof(DWORD))
+      continue;
+    sum += image[i] | (i + 1 < size ? image[i + 1] << 8 : 0);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  }
+  sum = (sum & 0xFFFF) + (sum >> 16);
+  return (DWORD)(sum + size);
+}
+
+
+// ---------------------------- Read Resources ----------------------------- //
+struct PeResourceReader {
+  const BYTE      *image;
+  size_t          size;
+  const PeImage   &pe;
+  size_t          root;             // file offset of the root directory
+  size_t          length;           // of the whole resource directory
+  vector<PeResource> &resources;
+  size_t          copied;           // data bytes read so far, see data()
+
+  template <class T>
+  bool get(size_t offset, T &value) {
+    if (!PeInRange(length, offset, sizeof(T)))
+      return false;
+    memcpy(&value, image + root + offset, sizeof(T));
+    return true;
+  }
+
+  bool key(DWORD entry, PeResourceKey &key) {
+    key = PeResourceKey();
+    if (!(entry & PE_SUBDIRECTORY)) {
+      key.id = (WORD)entry;
+      return true;
+    }
+    WORD characters = 0;
+    size_t offset = entry & ~PE_SUBDIRECTORY;
+    if (!get(offset, characters) ||
+        !PeInRange(length, offset + sizeof(WORD),
+                   (size_t)characters * sizeof(wchar_t)))
+      return false;
+    key.name.resize(characters);
+    memcpy(key.name.data(), image + root + offset + sizeof(WORD),
+           characters * sizeof(wchar_t));
+    return true;
+  }
+
+  // Entries of the directory at OFFSET; LEVEL 0 is the type
+  bool directory(size_t offset, int level, PeResource &resource) {
+    IMAGE_RESOURCE_DIRECTORY header;
+    if (level >= PE_RESOURCE_LEVELS || !get(offset, header))
+      return false;
+
+    size_t count = (size_t)header.NumberOfNamedEntries +
+                   header.NumberOfIdEntries;
+    for (size_t i = 0; i < count; i++) {
+      DWORD entry[2];
+      if (!get(offset + sizeof(header) + i * sizeof(entry), entry))
+        return false;
+
+      if (level == 0 && !key(entry[0], resource.type)) return false;
+      if (level == 1 && !key(entry[0], resource.name)) return false;
+      if (level == 2) resource.language = (WORD)entry[0];
+
+      if (entry[1] & PE_SUBDIRECTORY) {
+        if (!directory(entry[1] & ~PE_SUBDIRECTORY, level + 1, resource))
+          return false;
+      }
+      else if (!data(entry[1], resource))
+        return false;
+    }
+    return true;
+  }
+
+  // Entries may share data or directories, so a hostile image could expand
+  // into far more than it holds; genuine resources never add up to more
+  bool data(size_t offset, PeResource &resource) {
+    IMAGE_RESOURCE_DATA_ENTRY entry;
+    size_t position = 0;
+    if (!get(offset, entry) ||
+        !PeOffset(pe, size, entry.OffsetToData, entry.Size, position) ||
+        resources.size() >= PE_RESOURCE_LIMIT ||
+        entry.Size > size - copied)
+      return false;
+    copied += entry.Size;
+    resource.data.assign(image + position, image + position + entry.Size);
+    resources.push_back(resource);
+    return true;
+  }
+};
+
+/**@brief  Lists the resources of an image
+ *
+ * @param  IMAGE:     the image, as it is on disk
+ * @param  SIZE:      its size in bytes
+ * @param  RESOURCES: receives them, in directory order
+ *
+ * @return FALSE if IMAGE is not an image or its resources are malformed; an
+ *         image without resources gives an empty list
+ */
+inline bool PeReadResources(const BYTE *image, size_t size,
+                            vector<PeResource> &resources) {
+  resources.clear();
+  PeImage pe;
+  if (!PeParse((BYTE *)image, size, pe))
+    return false;
+  if (pe.directoryCount <= IMAGE_DIRECTORY_ENTRY_RESOURCE ||
+      !pe.directories[IMAGE_DIRECTORY_ENTRY_RESOURCE].VirtualAddress)
+    return true;
+
+  const IMAGE_DATA_DIRECTORY &directory =
+    pe.directories[IMAGE_DIRECTORY_ENTRY_RESOURCE];
+  size_t root = 0;
+  if (!PeOffset(pe, size, directory.VirtualAddress, directory.Size, root))
+    return false;
+
+  PeResourceReader reader = {image, size, pe, root, directory.Size, resources, 0};
+  PeResource resource;
+  return reader.directory(0, 0, resource);
+}
+
+// Adds RESOURCE to RESOURCES, replacing one with the same type, name and
+// language
+inline void PeSetResource(vector<PeResource> &resources, PeResource resource) {
+  for (PeResource &existing : resources) {
+    if (!PeCompare(existing.type, resource.type) &&
+        !PeCompare(existing.name, resource.name) &&
+        existing.language == resource.language) {
+      existing = move(resource);
+      return;
+    }
+  }
+  resources.push_back(move(resource));
+}
+
+
+// ---------------------------- Write Resources ---------------------------- //
+// Lays out a resource section for RVA: the three directory levels, the data
+// entries, the name strings, then the data itself
+inline vector<BYTE> PeBuildResources(vector<PeResource> resources, DWORD rva) {
+  sort(resources.begin(), resources.end(), PeResourceLess);
+
+  // Index ranges of every type, and of every name within a type
+  struct Range { size_t first, last; size_t offset; };
+  vector<Range> types, names;
+  for (size_t i = 0; i < resources.size(); i++) {
+    bool newType = i == 0 || PeCompare(resources[i].type, resources[i-1].type);
+    if (newType)
+      types.push_back({i, i, 0});
+    if (newType || PeCompare(resources[i].name, resources[i-1].name))
+      names.push_back({i, i, 0});
+    types.back().last = names.back().last = i + 1;
+  }
+
+  const size_t header = sizeof(IMAGE_RESOURCE_DIRECTORY);
+  const size_t entry  = sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY);
+  size_t offset = header + types.size() * entry;
+  for (size_t t = 0, n = 0; t < types.size(); t++) {
+    types[t].offset = offset;
+    for (; n < names.size() && names[n].first < types[t].last; n++)
+      offset += entry;
+    offset += header;
+  }
+  for (Range &name : names) {
+    name.offset = offset;
+    offset += header + (name.last - name.first) * entry;
+  }
+
+  size_t dataEntries = offset;
+  size_t strings     = dataEntries +
+                       resources.size() * sizeof(IMAGE_RESOURCE_DATA_ENTRY);
+  size_t stringSize  = 0;
+  for (const Range &type : types)
+    if (!resources[type.first].type.name.empty())
+      stringSize += sizeof(WORD) +
+                    resources[type.first].type.name.size() * sizeof(wchar_t);
+  for (const Range &name : names)
+    if (!resources[name.first].name.name.empty())
+      stringSize += sizeof(WORD) +
+                    resources[name.first].name.name.size() * sizeof(wchar_t);
+
+  size_t data = PeAlign(strings + stringSize, PE_RESOURCE_ALIGN);
+  size_t total = data;
+  for (const PeResource &resource : resources)
+    total = PeAlign(total + resource.data.size(), PE_RESOURCE_ALIGN);
+
+  vector<BYTE> section(total, 0);
+  auto put = [&](size_t at, DWORD value) {
+    memcpy(section.data() + at, &value, sizeof(value));
+  };
+  size_t nextString = strings;
+  auto putKey = [&](size_t at, const PeResourceKey &key) {
+    if (key.name.empty()) {
+      put(at, key.id);
+      return;
+    }
+    put(at, PE_SUBDIRECTORY | (DWORD)nextString);
+    WORD characters = (WORD)key.name.size();
+    memcpy(section.data() + nextString, &characters, sizeof(WORD));
+    memcpy(section.data() + nextString + sizeof(WORD), key.name.data(),
+           characters * sizeof(wchar_t));
+    nextString += sizeof(WORD) + characters * sizeof(wchar_t);
+  };
+  // Directory header with NAMED string entries out of COUNT; the time stamp
+  // and version stay zero so equal input gives equal output
+  auto putDirectory = [&](size_t at, size_t named, size_t count) {
+    IMAGE_RESOURCE_DIRECTORY directory = {};
+    directory.NumberOfNamedEntries = (WORD)named;
+    directory.NumberOfIdEntries    = (WORD)(count - named);
+    memcpy(section.data() + at, &directory, sizeof(directory));
+  };
+
+  // Root: one entry per type
+  size_t named = 0;
+  for (size_t t = 0; t < types.size(); t++) {
+    named += !resources[types[t].first].type.name.empty();
+    putKey(header + t * entry, resources[types[t].first].type);
+    put(header + t * entry + sizeof(DWORD),
+        PE_SUBDIRECTORY | (DWORD)types[t].offset);
+  }
+  putDirectory(0, named, types.size());
+
+  // Types: one entry per name
+  size_t n = 0;
+  for (const Range &type : types) {
+    size_t count = 0;
+    named = 0;
+    for (; n < names.size() && names[n].first < type.last; n++, count++) {
+      size_t at = type.offset + header + count * entry;
+      named += !resources[names[n].first].name.name.empty();
+      putKey(at, resources[names[n].first].name);
+      put(at + sizeof(DWORD), PE_SUBDIRECTORY | (DWORD)names[n].offset);
+    }
+    putDirectory(type.offset, named, count);
+  }
+
+  // Names: one entry per language, pointing at the data entries
+  size_t position = data;
+  for (const Range &name : names) {
+    putDirectory(name.offset, 0, name.last - name.first);
+    for (size_t i = name.first; i < name.last; i++) {
+      size_t at = name.offset + header + (i - name.first) * entry;
+      put(at, resources[i].language);
+      put(at + sizeof(DWORD),
+          (DWORD)(dataEntries + i * sizeof(IMAGE_RESOURCE_DATA_ENTRY)));
+
+      IMAGE_RESOURCE_DATA_ENTRY dataEntry = {};
+      dataEntry.OffsetToData = rva + (DWORD)position;
+      dataEntry.Size         = (DWORD)resources[i].data.size();
+      memcpy(section.data() + dataEntries +
+             i * sizeof(IMAGE_RESOURCE_DATA_ENTRY),
+             &dataEntry, sizeof(dataEntry));
+      if (!resources[i].data.empty())
+        memcpy(section.data() + position, resources[i].data.data(),
+               resources[i].data.size());
+      position = PeAlign(position + resources[i].data.size(),
+                         PE_RESOURCE_ALIGN);
+    }
+  }
+  return section;
+}
+
+/**@brief  Replaces the resources of an image
+ *
+ * The new resource section takes the place of the old one. It has to be the
+ * last section or be followed only by the base relocations (the layout the
+ * linker produces), which are moved up behind it. Anything past the last
+ * section, such as a signature, is dropped and the checksum recomputed.
+ *
+ * @param  IMAGE:     the image, rewritten in place
+ * @param  RESOURCES: the complete new list
+ *
+ * @return FALSE if IMAGE has no resource section or another layout
+ */
+inline bool PeWriteResources(vector<BYTE> &image,
+                             const vector<PeResource> &resources) {
+  PeImage pe;
+  if (!PeParse(image.data(), image.size(), pe) ||
+      pe.directoryCount <= IMAGE_DIRECTORY_ENTRY_BASERELOC)
+    return false;
+
+  // The section the resource directory starts
+  WORD count = pe.file->NumberOfSections;
+  DWORD rva  = pe.directories[IMAGE_DIRECTORY_ENTRY_RESOURCE].VirtualAddress;
+  WORD index = 0;
+  while (index < count && pe.sections[index].VirtualAddress != rva)
+    index++;
+  if (!rva || index == count)
+    return false;
+
+  // Only the relocations can follow, as nothing but their directory points
+  // into them
+  DWORD relocations = pe.directories[IMAGE_DIRECTORY_ENTRY_BASERELOC].VirtualAddress;
+  for (WORD i = index + 1; i < count; i++)
+    if (i != count - 1 || pe.sections[i].VirtualAddress != relocations)
+      return false;
+  for (WORD i = index; i < count; i++)
+    if (!PeInRange(image.size(), pe.sections[i].PointerToRawData,
+                   pe.sections[i].SizeOfRawData) ||
+        (i > index &&
+         pe.sections[i].PointerToRawData < pe.sections[i-1].PointerToRawData))
+      return false;
+
+  vector<BYTE> section = PeBuildResources(resources, rva);
+  IMAGE_SECTION_HEADER old = pe.sections[index];
+  DWORD rawSize = PeAlign(section.size(), pe.fileAlignment);
+
+  // Everything before the resource section stays where it is
+  vector<BYTE> tail;
+  if (index + 1 < count) {
+    const IMAGE_SECTION_HEADER &last = pe.sections[count - 1];
+    tail.assign(image.begin() + last.PointerToRawData,
+                image.begin() + last.PointerToRawData + last.SizeOfRawData);
+  }
+  image.reserve((size_t)old.PointerToRawData + rawSize + tail.size());
+  image.resize(old.PointerToRawData);
+  image.insert(image.end(), section.begin(), section.end());
+  image.resize(old.PointerToRawData + rawSize, 0);
+
+  // Headers are in front of the resource section, so they survived as is,
+  // and nothing moves them again with the space reserved above
+  PeParse(image.data(), image.size(), pe);
+  IMAGE_SECTION_HEADER &resource = pe.sections[index];
+  resource.Misc.VirtualSize = (DWORD)section.size();
+  resource.SizeOfRawData    = rawSize;
+  pe.directories[IMAGE_DIRECTORY_ENTRY_RESOURCE].Size = (DWORD)section.size();
+  *pe.sizeOfData += rawSize - old.SizeOfRawData;
+
+  if (index + 1 < count) {
+    IMAGE_SECTION_HEADER &moved = pe.sections[count - 1];
+    DWORD address = PeAlign((ULONGLONG)rva + section.size(),
+                            pe.sectionAlignment);
+    pe.directories[IMAGE_DIRECTORY_ENTRY_BASERELOC].VirtualAddress =
+      relocations - moved.VirtualAddress + address;
+    moved.VirtualAddress   = address;
+    moved.PointerToRawData = (DWORD)image.size();
+    image.insert(image.end(), tail.begin(), tail.end());
+  }
+
+  const IMAGE_SECTION_HEADER &last = pe.sections[count - 1];
+  *pe.sizeOfImage = PeAlign((ULONGLONG)last.VirtualAddress +
+                            max(last.Misc.VirtualSize, last.SizeOfRawData),
+                            pe.sectionAlignment);
+  if (pe.directoryCount > IMAGE_DIRECTORY_ENTRY_SECURITY)
+    pe.directories[IMAGE_DIRECTORY_ENTRY_SECURITY] = {};
+  *pe.checkSum = PeChecksum(image.data(), image.size(),
+                            (BYTE *)pe.checkSum - image.data());
+  return true;
+}
+
+/**@brief  Sets the link time recorded in an image
+ *
+ * Written to the file header and every debug directory entry, the only
+ * places the linker puts one, so an image linked with -Brepro and stamped
+ * with a fixed time is the same on every machine. The checksum is left to
+ * PeWriteResources.
+ *
+ * @param  IMAGE:     the image, changed in place
+ * @param  STAMP:     seconds since 1970 (e.g. SOURCE_DATE_EPOCH)
+ *
+ * @return FALSE if IMAGE is not an image
+ */
+inline bool PeSetTimestamp(vector<BYTE> &image, DWORD stamp) {
+  PeImage pe;
+  if (!PeParse(image.data(), image.size(), pe))
+    return false;
+  pe.file->TimeDateStamp = stamp;
+
+  if (pe.directoryCount <= IMAGE_DIRECTORY_ENTRY_DEBUG)
+    return true;
+  const IMAGE_DATA_DIRECTORY &debug =
+    pe.directories[IMAGE_DIRECTORY_ENTRY_DEBUG];
+  size_t offset = 0;
+  if (debug.VirtualAddress &&
+      PeOffset(pe, image.size(), debug.VirtualAddress, debug.Size, offset)) {
+    for (DWORD i = 0; i < debug.Size / sizeof(IMAGE_DEBUG_DIRECTORY); i++) {
+      IMAGE_DEBUG_DIRECTORY entry;
+      BYTE *at = image.data() + offset + i * sizeof(entry);
+      memcpy(&entry, at, sizeof(entry));
+      entry.TimeDateStamp = stamp;
+      memcpy(at, &entry, sizeof(entry));
+    }
+  }
+  return true;
+}
+
+// ------------------------------------------------------------------------- //
+#endif  // PE_RESOURCES_H
@@ -28,6 +28,10 @@
 // ------------------------------------------------------------------------- //
 #include <string>
 #include <log.h>
+#include <shim_builder.h>
+
+// Characters reserved for path resources so they can be retargeted in place
+#define RESOURCE_PATH_RESERVE SHIM_BUILD_PATH_RESERVE
 
 // ---------------------------- Read Resources ----------------------------- // 
 bool HasResourceData(LPCSTR name) {
@@ -36,21 +40,27 @@ bool HasResourceData(LPCSTR name) {
   return false;
 }
 
-bool GetResourceData(LPCSTR name, wstring& arg) {
+// From MODULE, e.g. another shim loaded with LOAD_LIBRARY_AS_DATAFILE
+bool GetResourceData(HMODULE module, LPCSTR name, wstring& arg) {
   // Get the resource handle if it exists 
-  HRSRC     resource    = FindResource(NULL, name, RT_RCDATA);
+  HRSRC     resource    = FindResource(module, name, RT_RCDATA);
   if (!resource) return false;
   
   // Load the data
-  HGLOBAL   data        = LoadResource(NULL, resource);
+  HGLOBAL   data        = LoadResource(module, resource);
   LPVOID    data_ptr    = LockResource(data);
-  DWORD     data_size   = SizeofResource(NULL, resource);
+  DWORD     data_size   = SizeofResource(module, resource);
 
-  // Its assumed to be a WSTRING so convert
-  arg = wstring((LPCWSTR)data_ptr, data_size / sizeof(WCHAR));
+  // Its assumed to be a WSTRING so convert, dropping any reserved padding
+  arg = wstring((LPCWSTR)data_ptr,
+                wcsnlen((LPCWSTR)data_ptr, data_size / sizeof(WCHAR)));
   return true;
 }
 
+bool GetResourceData(LPCSTR name, wstring& arg) {
+  return GetResourceData(NULL, name, arg);
+}
+
 bool GetResourceFile(string name, const filesystem::path& path) {
   // Get the resource handle if it exists 
   HRSRC     resource    = FindResource(NULL, name.c_str(), RT_RCDATA);
@@ -78,29 +88,50 @@ bool GetResourceFile(string name, const filesystem::path& path) {
 
 
 // ----------------------------- Add Resources ----------------------------- // 
-BOOL AddResourceData (filesystem::path target, LPCSTR name, wstring arg) {
+// RESERVE pads the string with NULs to that many characters, leaving room to
+// rewrite it in place later
+BOOL AddResourceData (filesystem::path target, LPCSTR name, wstring arg,
+                      size_t reserve = 0) {
+  wstring data      = arg;
+  if (data.size() < reserve)
+    data.resize(reserve, L'\0');
+
   HANDLE resource   = BeginUpdateResourceW(target.c_str(), FALSE);
+  if (!resource) {
+    LOG(1) << "Could not open " << target << " to add resource: " << name;
+    return FALSE;
+  }
+
   BOOL bUpdate      = UpdateResource(
       resource,                 // Handle
       RT_RCDATA,                // Resource Type
       name,                     // Resource Name
       MAKELANGID(LANG_NEUTRAL, SUBLANG_NEUTRAL),
-      (LPVOID)arg.c_str(),      // Resource String
-      arg.size() * sizeof(wchar_t));
+      (LPVOID)data.c_str(),     // Resource String
+      data.size() * sizeof(wchar_t));
   
   if (!bUpdate)
     LOG(1) << "Failed to add resource: " << name;
   else 
     LOG(3) << "Added resource: " << name << " = " << arg;
 
-  EndUpdateResource(resource, FALSE);
+  // Nothing is written unless the update went through
+  if (!EndUpdateResource(resource, !bUpdate) && bUpdate) {
+    LOG(1) << "Could not write resource: " << name;
+    return FALSE;
+  }
   
   return bUpdate;
 }
 
 
 // ---------------------------- Copy Resources ----------------------------- //
-HANDLE resource_handle;
+// Passed through lParam so several copies can run at once
+struct ResourceCopy {
+  HANDLE    update;
+  bool      config;             // RT_RCDATA too, i.e. the shim settings
+  bool      failed = false;     // stops the enumeration
+};
 
 BOOL CALLBACK enumLangsFunc(HMODULE hModule, LPCSTR lpType, LPCSTR lpName,
                             WORD wLang, LONG_PTR lParam) {
@@ -109,9 +140,14 @@ BOOL CALLBACK enumLangsFunc(HMODULE hModule, LPCSTR lpType, LPCSTR lpName,
   HGLOBAL hResLoad =    LoadResource(hModule, hRes);
   LPVOID lpResLock =    LockResource(hResLoad);
 
-  UpdateResource(resource_handle, lpType, lpName, wLang,
-                 lpResLock,                        // ptr to resource info
-                 SizeofResource(hModule, hRes));   // size of resource info
+  ResourceCopy *copy =  (ResourceCopy*)lParam;
+  if (!lpResLock ||
+      !UpdateResource(copy->update, lpType, lpName, wLang,
+                      lpResLock,                        // ptr to resource info
+                      SizeofResource(hModule, hRes))) { // size of resource info
+    copy->failed = true;
+    return FALSE;
+  }
 
   string log_str = "Copied ";
   
@@ -121,6 +157,8 @@ BOOL CALLBACK enumLangsFunc(HMODULE hModule, LPCSTR lpType, LPCSTR lpName,
     log_str += "VERSION ";
   else if (lpType == RT_GROUP_ICON)
     log_str += "ICON GROUP ";
+  else if (lpType == RT_RCDATA)
+    log_str += "RCDATA ";
 
   log_str += "resource ";
   if (!IS_INTRESOURCE(lpName))
@@ -135,20 +173,21 @@ BOOL CALLBACK enumLangsFunc(HMODULE hModule, LPCSTR lpType, LPCSTR lpName,
 
 BOOL CALLBACK enumNamesFunc(HMODULE hModule, LPCSTR lpType, LPSTR lpName,
                             LONG_PTR lParam) {
-  EnumResourceLanguagesA(hModule, lpType, lpName, enumLangsFunc, 0);
-  return TRUE;
+  EnumResourceLanguagesA(hModule, lpType, lpName, enumLangsFunc, lParam);
+  return !((ResourceCopy*)lParam)->failed;
 }
 
 BOOL CALLBACK enumTypesFunc(HMODULE hModule, LPSTR lpType, LONG_PTR lParam) {
   // Only Copy Icons and Version Info
-  if(lpType == RT_ICON || lpType == RT_VERSION || lpType == RT_GROUP_ICON)
-    EnumResourceNamesA(hModule, lpType, enumNamesFunc, 0);
-  return TRUE;
+  if(lpType == RT_ICON || lpType == RT_VERSION || lpType == RT_GROUP_ICON ||
+     (lpType == RT_RCDATA && ((ResourceCopy*)lParam)->config))
+    EnumResourceNamesA(hModule, lpType, enumNamesFunc, lParam);
+  return !((ResourceCopy*)lParam)->failed;
 }
 
-BOOL CopyResources(filesystem::path target, filesystem::path source) {
-  resource_handle = BeginUpdateResourceW(target.c_str(), FALSE);
-  
+// CONFIG also copies the RCDATA settings, to carry a shim over to a new one
+BOOL CopyResources(filesystem::path target, filesystem::path source,
+                   bool config = false) {
   HMODULE hExe =
     LoadLibraryExW(source.c_str(), NULL, LOAD_LIBRARY_AS_DATAFILE);
   
@@ -157,16 +196,30 @@ BOOL CopyResources(filesystem::path target, filesystem::path source) {
     return false;
   }
 
-  EnumResourceTypesA(hExe, enumTypesFunc, 0);
+  ResourceCopy copy = {BeginUpdateResourceW(target.c_str(), FALSE), config};
+  if (!copy.update) {
+    LOG(1) << "Could not open " << target << " to copy resources";
+    FreeLibrary(hExe);
+    return false;
+  }
+
+  EnumResourceTypesA(hExe, enumTypesFunc, (LONG_PTR)&copy);
 
-  EndUpdateResource(resource_handle, FALSE);
+  // A failed copy discards every update, so TARGET is left as it was
+  if (copy.failed)
+    LOG(1) << "Could not copy the resources of " << source;
+  if (!EndUpdateResource(copy.update, copy.failed) && !copy.failed) {
+    LOG(1) << "Could not write the resources of " << source << " to "
+           << target;
+    copy.failed = true;
+  }
   
   if (!FreeLibrary(hExe)){ 
     LOG(2) << "Could not free application library";
     return false;
   }
 
-  return true;
+  return !copy.failed;
 }
 
 // ------------------------------------------------------------------------- //
@@ -0,0 +1,88 @@
+// ------------------------------------------------------------------------- //
+// Script Interpreters                                                       //
+// ------------------------------------------------------------------------- //
+/**@file    SCRIPT_FUNCTIONS.H
+ * @brief   Starts a shimmed script in its interpreter
+ * @date    10/16/2026
+ *
+ * -------------------------------------------------------------------------
+ * CreateProcess only starts images; anything else goes through an implicit
+ * CMD.EXE (batch files) or fails. A shim of a script instead records the
+ * interpreter command line in SHIM_INTERPRETER when it is created, and
+ * starts the interpreter directly. In that command line %* stands for the
+ * quoted script followed by the arguments, or is appended when missing:
+ *
+ *      "C:\Windows\system32\cmd.exe" /d /s /c "%*"
+ *      "C:\...\powershell.exe" -NoProfile -File %*
+ *      "C:\Python312\python.exe" %*
+ *
+ * The command line is found by ScriptInterpreter (SCRIPT_INTERPRETER.H) in
+ * the generator; this part is what the shim needs to use it.
+ *
+ * Defines the following:
+ *
+ *  InterpreterCommand
+ *      the program and arguments to start a script with (imports nothing
+ *      beyond KERNEL32)
+ *
+ * -------------------------------------------------------------------------
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ * ------------------------------------------------------------------------- */
+
+#ifndef SCRIPT_FUNCTIONS_H
+#define SCRIPT_FUNCTIONS_H
+
+// ------------------------------------------------------------------------- //
+#include <windows.h>
+#include <string>
+#include <algorithm>
+
+#define SCRIPT_ARGUMENTS  L"%*"
+
+using namespace std;
+
+/**@brief  Splits an interpreter command line for starting SCRIPT
+ *
+ * @param  INTERPRETER: as recorded in SHIM_INTERPRETER
+ * @param  SCRIPT:      full path of the script
+ * @param  ARGS:        arguments for the script
+ * @param  PROGRAM:     set to the interpreter, unquoted
+ * @param  PROGRAM_ARGS: set to its arguments, including the script
+ */
+void InterpreterCommand(const wstring &interpreter, const wstring &script,
+                        const wstring &args, wstring &program,
+                        wstring &program_args) {
+  size_t end = interpreter.front() == L'"' ?
+    interpreter.find(L'"', 1) : interpreter.find(L' ');
+  if (end == wstring::npos)
+    end = interpreter.size();
+  program = interpreter.substr(interpreter.front() == L'"',
+                               end - (interpreter.front() == L'"'));
+
+  program_args = interpreter.substr(min(end + 1, interpreter.size()));
+  size_t start = program_args.find_first_not_of(L' ');
+  program_args.erase(0, start == wstring::npos ? program_args.size() : start);
+
+  wstring command = L"\"" + script + L"\"";
+  if (!args.empty())
+    command += L" " + args;
+  size_t at = program_args.find(SCRIPT_ARGUMENTS);
+  if (at == wstring::npos)
+    program_args += (program_args.empty() ? L"" : L" ") + command;
+  else
+    program_args.replace(at, wcslen(SCRIPT_ARGUMENTS), command);
+}
+
+// ------------------------------------------------------------------------- //
+#endif  // SCRIPT_FUNCTIONS_H
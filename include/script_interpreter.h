@@ -0,0 +1,130 @@
+// ------------------------------------------------------------------------- //
+// Script Interpreters                                                       //
+// ------------------------------------------------------------------------- //
+/**@file    SCRIPT_INTERPRETER.H
+ * @brief   Finds the interpreter a shimmed script is started with
+ * @date    10/16/2026
+ *
+ * -------------------------------------------------------------------------
+ * Used by the generator when it shims a script; the shim only reads the
+ * result back from SHIM_INTERPRETER (see SCRIPT_FUNCTIONS.H).
+ *
+ * Defines the following:
+ *
+ *  SearchProgram
+ *      a program in the directories on the PATH, and only there
+ *
+ *  ScriptInterpreter
+ *      the interpreter command line for a script, by its extension
+ *
+ * -------------------------------------------------------------------------
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ * ------------------------------------------------------------------------- */
+
+#ifndef SCRIPT_INTERPRETER_H
+#define SCRIPT_INTERPRETER_H
+
+// ------------------------------------------------------------------------- //
+#include <windows.h>
+#include <string>
+#include <filesystem>
+#include <utility_functions.h>
+#include <script_functions.h>
+
+using namespace std;
+
+/**@brief  Full path of a program on the PATH
+ *
+ * Only the directories listed in PATH are searched. SearchPath would look in
+ * the application's and the current directory first, where anyone who can
+ * write there could plant a python.exe that every shim then runs. Relative
+ * entries are skipped for the same reason, and so are the Microsoft Store
+ * placeholders (App Execution Aliases in WindowsApps) that only offer to
+ * install the program.
+ *
+ * @param  PROGRAM:   file name, e.g. python.exe
+ *
+ * @return full path, empty if not found
+ */
+wstring SearchProgram(const wstring &program) {
+  wstring paths = GetEnvironment(L"PATH");
+  for (size_t start = 0; start < paths.size(); ) {
+    size_t end = paths.find(L';', start);
+    if (end == wstring::npos)
+      end = paths.size();
+    wstring directory = paths.substr(start, end - start);
+    start = end + 1;
+
+    if (directory.size() >= 2 && directory.front() == L'"' &&
+        directory.back() == L'"')
+      directory = directory.substr(1, directory.size() - 2);
+    filesystem::path candidate = filesystem::path(directory) / program;
+    wstring upper = directory;
+    UpperCase(upper);
+    if (directory.empty() || candidate.is_relative() ||
+        upper.find(L"\\WINDOWSAPPS") != wstring::npos)
+      continue;
+
+    DWORD attributes = GetFileAttributesW(candidate.c_str());
+    if (attributes != INVALID_FILE_ATTRIBUTES &&
+        !(attributes & FILE_ATTRIBUTE_DIRECTORY))
+      return candidate.wstring();
+  }
+  return L"";
+}
+
+
+/**@brief  Command line to start a script with
+ *
+ * Batch files run in %ComSpec% (without AutoRun commands), PowerShell
+ * scripts in Windows PowerShell and Python scripts in the python.exe (or
+ * pythonw.exe) on the PATH, else the py.exe launcher.
+ *
+ * @param  PATH:  the script
+ *
+ * @return interpreter command line, empty if PATH is not a known script or
+ *         no interpreter was found
+ */
+wstring ScriptInterpreter(const filesystem::path &path) {
+  wstring extension = path.extension().wstring();
+  UpperCase(extension);
+
+  wstring program;
+  wstring arguments;
+  if (extension == L".BAT" || extension == L".CMD") {
+    program = GetEnvironment(L"ComSpec");
+    if (program.empty())
+      program = SearchProgram(L"cmd.exe");
+    // /s takes the outer quotes off, leaving any in the script path intact
+    arguments = L"/d /s /c \"" SCRIPT_ARGUMENTS L"\"";
+  }
+  else if (extension == L".PS1") {
+    program = SearchProgram(L"powershell.exe");
+    arguments = L"-NoProfile -File " SCRIPT_ARGUMENTS;
+  }
+  else if (extension == L".PY" || extension == L".PYW") {
+    program = SearchProgram(extension == L".PY" ? L"python.exe" :
+                                                  L"pythonw.exe");
+    if (program.empty())
+      program = SearchProgram(extension == L".PY" ? L"py.exe" : L"pyw.exe");
+    arguments = SCRIPT_ARGUMENTS;
+  }
+
+  if (program.empty())
+    return L"";
+  return L"\"" + program + L"\" " + arguments;
+}
+
+// ------------------------------------------------------------------------- //
+#endif  // SCRIPT_INTERPRETER_H
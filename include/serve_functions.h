@@ -0,0 +1,531 @@
+// ------------------------------------------------------------------------- //
+// Generator Server                                                          //
+// ------------------------------------------------------------------------- //
+/**@file    SERVE_FUNCTIONS.H
+ * @brief   Creates shims on request for as long as stdin stays open
+ * @date    10/16/2026
+ *
+ * -------------------------------------------------------------------------
+ * shim_exec --serve reads one JSON object per line on stdin and answers each
+ * with one JSON line on stdout. A request holds the generator's arguments,
+ * named like the flags without dashes, plus an optional "id" which is
+ * echoed back as is:
+ *
+ *      {"id": 7, "path": "C:\\tools\\app.exe", "output": "C:\\shims",
+ *       "timeout": 30, "gui": true}
+ *
+ *      {"id": 7, "ok": true, "output": "C:\\shims\\app.exe", "bytes": 59904}
+ *      {"id": 8, "ok": false, "error": "..."}
+ *
+ * Generator arguments that do nothing here (iconpath, debug) are answered
+ * with a "warnings" list next to the result.
+ *
+ * Requests are handled by a pool of threads, so responses can arrive in a
+ * different order than the requests. Relative paths are taken from the
+ * server's current directory. The templates are decompressed from this
+ * program's template store once and kept, and source files are kept in
+ * memory (until they change) for the next shim of the same executable.
+ * Requests for the same output take turns writing it and its sidecar, and
+ * a shim is written next to the output and then moved over it, so it is
+ * never seen half written.
+ *
+ *  Serve
+ *      runs the server until stdin is closed
+ *
+ * -------------------------------------------------------------------------
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ * ------------------------------------------------------------------------- */
+
+#ifndef SERVE_FUNCTIONS_H
+#define SERVE_FUNCTIONS_H
+
+// ------------------------------------------------------------------------- //
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <iostream>
+#include <filesystem>
+#include <shim_builder.h>
+#include <utility_functions.h>
+#include <script_interpreter.h>
+#include <sidecar.h>
+
+#define SERVE_CACHE_BYTES (256ULL << 20)    // source files kept in memory
+#define SERVE_OUTPUT_LOCKS 64                 // outputs written at once
+
+using namespace std;
+
+// --------------------------------- JSON ---------------------------------- //
+struct JsonField {
+  string    raw;                // as written, e.g. to echo the id
+  string    text;               // string contents, or the literal itself
+};
+
+void AppendUtf8(string &out, unsigned code) {
+  if (code < 0x80)
+    out += (char)code;
+  else if (code < 0x800) {
+    out += (char)(0xC0 | code >> 6);
+    out += (char)(0x80 | (code & 0x3F));
+  }
+  else if (code < 0x10000) {
+    out += (char)(0xE0 | code >> 12);
+    out += (char)(0x80 | (code >> 6 & 0x3F));
+    out += (char)(0x80 | (code & 0x3F));
+  }
+  else {
+    out += (char)(0xF0 | code >> 18);
+    out += (char)(0x80 | (code >> 12 & 0x3F));
+    out += (char)(0x80 | (code >> 6 & 0x3F));
+    out += (char)(0x80 | (code & 0x3F));
+  }
+}
+
+// Reads a flat JSON object: string, number, true, false or null values only
+class JsonReader {
+public:
+  JsonReader(const string &text) : text(text) {}
+
+  bool Object(map<string, JsonField> &fields) {
+    space();
+    if (!take('{'))
+      return false;
+    space();
+    if (take('}'))
+      return end();
+
+    while (true) {
+      string key;
+      JsonField field;
+      space();
+      if (!quoted(key))
+        return false;
+      space();
+      if (!take(':'))
+        return false;
+      space();
+
+      size_t start = pos;
+      if (peek() == '"' ? !quoted(field.text) : !literal(field.text))
+        return false;
+      field.raw = text.substr(start, pos - start);
+      fields[key] = field;
+
+      space();
+      if (take('}'))
+        return end();
+      if (!take(','))
+        return false;
+    }
+  }
+
+private:
+  const string  &text;
+  size_t        pos = 0;
+
+  char peek() { return pos < text.size() ? text[pos] : '\0'; }
+  bool take(char c) { return peek() == c && ++pos; }
+  void space() { while (peek() && strchr(" \t\r\n", peek())) pos++; }
+  bool end() { space(); return pos == text.size(); }
+
+  bool hex(unsigned &code) {
+    if (pos + 4 > text.size())
+      return false;
+    code = 0;
+    for (int i = 0; i < 4; i++) {
+      char c = text[pos++];
+      code <<= 4;
+      if (c >= '0' && c <= '9')       code |= c - '0';
+      else if (c >= 'a' && c <= 'f')  code |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')  code |= c - 'A' + 10;
+      else return false;
+    }
+    return true;
+  }
+
+  bool quoted(string &out) {
+    if (!take('"'))
+      return false;
+    while (peek() != '"') {
+      char c = peek();
+      if (!c || (unsigned char)c < 0x20)
+        return false;
+      pos++;
+      if (c != '\\') {
+        out += c;
+        continue;
+      }
+
+      unsigned code = 0;
+      switch (char e = peek(); pos++, e) {
+        case '"': case '\\': case '/': out += e;    break;
+        case 'b': out += '\b';                      break;
+        case 'f': out += '\f';                      break;
+        case 'n': out += '\n';                      break;
+        case 'r': out += '\r';                      break;
+        case 't': out += '\t';                      break;
+        case 'u':
+          if (!hex(code))
+            return false;
+          // A surrogate pair is one character
+          if (code >= 0xD800 && code < 0xDC00 &&
+              text.compare(pos, 2, "\\u") == 0) {
+            unsigned low = 0;
+            pos += 2;
+            if (!hex(low) || low < 0xDC00 || low >= 0xE000)
+              return false;
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+          }
+          AppendUtf8(out, code);
+          break;
+        default:
+          return false;
+      }
+    }
+    pos++;
+    return true;
+  }
+
+  bool literal(string &out) {
+    size_t start = pos;
+    while (peek() && strchr("+-.0123456789Eaeflnrstu", peek()))
+      pos++;
+    out = text.substr(start, pos - start);
+    return out == "true" || out == "false" || out == "null" ||
+      (!out.empty() && strchr("-0123456789", out[0]) &&
+       out.find_first_of("aflnrstu") == string::npos);
+  }
+};
+
+
+// ------------------------------ Source Cache ----------------------------- //
+// Source images by path, reused while their size and write time are the same
+class SourceCache {
+public:
+  shared_ptr<const vector<BYTE>> Get(const filesystem::path &path) {
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard,
+                              &attributes))
+      return nullptr;
+    ULONGLONG size    = ((ULONGLONG)attributes.nFileSizeHigh << 32) |
+                        attributes.nFileSizeLow;
+    ULONGLONG written = ((ULONGLONG)attributes.ftLastWriteTime.dwHighDateTime
+                         << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+    wstring key = path.wstring();
+    UpperCase(key);
+
+    {
+      lock_guard<mutex> guard(lock);
+      auto entry = entries.find(key);
+      if (entry != entries.end() && entry->second.size == size &&
+          entry->second.written == written)
+        return entry->second.image;
+    }
+
+    // Read outside the lock; two requests racing for the same new file both
+    // read it, which is harmless
+    auto image = make_shared<vector<BYTE>>();
+    if (!ReadFileData(path, *image))
+      return nullptr;
+
+    lock_guard<mutex> guard(lock);
+    auto entry = entries.find(key);
+    if (entry != entries.end()) {
+      bytes -= entry->second.image->size();
+      entries.erase(entry);
+    }
+    while (!entries.empty() && bytes + image->size() > SERVE_CACHE_BYTES) {
+      bytes -= entries.begin()->second.image->size();
+      entries.erase(entries.begin());
+    }
+    if (image->size() <= SERVE_CACHE_BYTES) {
+      entries[key] = {size, written, image};
+      bytes += image->size();
+    }
+    return image;
+  }
+
+private:
+  struct Entry {
+    ULONGLONG                       size;
+    ULONGLONG                       written;
+    shared_ptr<const vector<BYTE>>  image;
+  };
+  mutex                 lock;
+  map<wstring, Entry>   entries;
+  ULONGLONG             bytes = 0;
+};
+
+
+// -------------------------------- Requests ------------------------------- //
+// Request fields that go to the builder as they are
+struct ServeSetting {
+  const char                    *name;
+  const wchar_t *ShimBuildConfig::*field;
+};
+
+const ServeSetting serve_settings[] = {
+  {"command",           &ShimBuildConfig::args},
+  {"wd-type",           &ShimBuildConfig::wdType},
+  {"wd-path",           &ShimBuildConfig::wdPath},
+  {"timeout",           &ShimBuildConfig::timeout},
+  {"timeout-grace",     &ShimBuildConfig::timeoutGrace},
+  {"memory-limit",      &ShimBuildConfig::memoryLimit},
+  {"job-memory-limit",  &ShimBuildConfig::jobMemoryLimit},
+  {"process-limit",     &ShimBuildConfig::processLimit},
+  {"cpu-rate",          &ShimBuildConfig::cpuRate},
+  {"priority",          &ShimBuildConfig::priority},
+  {"affinity",          &ShimBuildConfig::affinity},
+  {"power-throttling",  &ShimBuildConfig::powerThrottling},
+  {"memory-priority",   &ShimBuildConfig::memoryPriority},
+  {"io-priority",       &ShimBuildConfig::ioPriority},
+  {"tee",               &ShimBuildConfig::tee},
+  {"job-stats",         &ShimBuildConfig::jobStats},
+  {"journal",           &ShimBuildConfig::journal},
+  {"source-date-epoch", &ShimBuildConfig::sourceDateEpoch},
+  {"interpreter",       &ShimBuildConfig::interpreter},
+  {"response-file",     &ShimBuildConfig::responseFile},
+  {"arch",              &ShimBuildConfig::arch},
+};
+
+// Requests writing the same output share a lock, picked by the output's
+// path; different outputs rarely do
+mutex &ServeOutputLock(const filesystem::path &output) {
+  static mutex locks[SERVE_OUTPUT_LOCKS];
+  wstring key = output.wstring();
+  UpperCase(key);
+  return locks[hash<wstring>()(key) % SERVE_OUTPUT_LOCKS];
+}
+
+// Writes IMAGE to a file of this thread's next to OUTPUT and moves it over
+// OUTPUT, so readers see the old shim or the new one but nothing in between
+bool ServeWriteShim(const filesystem::path &output, const vector<BYTE> &image) {
+  filesystem::path temp = output;
+  temp += L"." + to_wstring(GetCurrentThreadId()) + L".tmp";
+  if (!WriteFileData(temp, image)) {
+    DeleteFileW(temp.c_str());
+    return false;
+  }
+  if (!MoveFileExW(temp.c_str(), output.c_str(),
+                   MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+    DeleteFileW(temp.c_str());
+    return false;
+  }
+  return true;
+}
+
+string ServeError(const string &id, const string &message) {
+  return "{\"id\": " + id + ", \"ok\": false, \"error\": " +
+    JsonString(WideString(message)) + "}";
+}
+
+string ServeBuild(const string &id, const map<string, JsonField> &fields,
+                  SourceCache &sources) {
+  auto text = [&](const char *name) {
+    auto field = fields.find(name);
+    return field == fields.end() || field->second.raw == "null" ?
+      wstring() : WideString(field->second.text);
+  };
+
+  // ---------- Settings ---------- //
+  ShimBuildConfig config = {sizeof(config)};
+  wstring values[size(serve_settings)];
+  for (size_t i = 0; i < size(serve_settings); i++) {
+    values[i] = text(serve_settings[i].name);
+    config.*serve_settings[i].field = values[i].c_str();
+  }
+
+  wstring type;
+  if (text("gui") == L"true")
+    type = L"GUI";
+  if (text("console") == L"true") {
+    if (!type.empty())
+      return ServeError(id, "gui and console cannot be used together");
+    type = L"CONSOLE";
+  }
+  config.type = type.c_str();
+  config.settings = text("sidecar") == L"true" ? L"SIDECAR" : L"EMBED";
+
+  // Like on the command line, SOURCE_DATE_EPOCH is the default
+  wstring epoch = GetEnvironment(L"SOURCE_DATE_EPOCH");
+  if (!*config.sourceDateEpoch)
+    config.sourceDateEpoch = epoch.c_str();
+
+  for (auto &[name, field] : fields) {
+    bool known = name == "path" || name == "output" || name == "gui" ||
+                 name == "console" || name == "iconpath" || name == "debug" ||
+                 name == "sidecar";
+    for (const ServeSetting &setting : serve_settings)
+      known = known || name == setting.name;
+    if (!known)
+      return ServeError(id, "unknown field '" + name + "'");
+  }
+
+  // Accepted like on the command line, where they do nothing either
+  vector<string> warnings;
+  if (!text("iconpath").empty())
+    warnings.push_back("iconpath is not implemented, ignored");
+  if (text("debug") == L"true")
+    warnings.push_back("debug has no effect on a server, ignored");
+
+  // ---------- Paths ---------- //
+  error_code error;
+  filesystem::path current = filesystem::current_path(error);
+  filesystem::path input   = text("path");
+  filesystem::path output  = text("output");
+  if (input.empty())
+    return ServeError(id, "path must be given");
+  if (input.is_relative())
+    input = filesystem::weakly_canonical(current / input, error);
+  if (!filesystem::is_regular_file(input, error))
+    return ServeError(id, "path '" + NarrowString(input.wstring()) +
+                      "' is not an existing file");
+
+  if (output.empty())
+    output = current;
+  if (output.is_relative())
+    output = filesystem::weakly_canonical(current / output, error);
+  if (filesystem::is_directory(output, error))
+    output /= input.filename();
+  if (!filesystem::is_directory(output.parent_path(), error))
+    return ServeError(id, "output directory '" +
+                      NarrowString(output.parent_path().wstring()) +
+                      "' does not exist");
+  if (filesystem::equivalent(output, input, error))
+    return ServeError(id, "output cannot overwrite path");
+
+  wstring path = input.wstring();
+  config.path = path.c_str();
+
+  // Scripts run in their interpreter unless the request names one
+  wstring interpreter = ScriptInterpreter(input);
+  if (!*config.interpreter)
+    config.interpreter = interpreter.c_str();
+  if (!SHGetFileInfoW(path.c_str(), 0, NULL, 0, SHGFI_EXETYPE) &&
+      !*config.interpreter)
+    return ServeError(id, "path '" + NarrowString(path) + "' must be an "
+                      "executable or a script (.bat, .cmd, .ps1, .py)");
+
+  // ---------- Build ---------- //
+  shared_ptr<const vector<BYTE>> source = sources.Get(input);
+  if (!source)
+    return ServeError(id, "could not read '" +
+                      NarrowString(input.wstring()) + "'");
+
+  vector<BYTE> image;
+  int result = ShimBuild(config, source->data(), source->size(), image);
+  if (result != SHIM_BUILD_OK)
+    return ServeError(id, ShimBuildMessage(result));
+
+  // ---------- Output ---------- //
+  {
+    lock_guard<mutex> guard(ServeOutputLock(output));
+    if (!ServeWriteShim(output, image))
+      return ServeError(id, "could not write '" +
+                        NarrowString(output.wstring()) + "'");
+    if (!UpdateSidecar(output, config))
+      return ServeError(id, "could not update '" +
+                        NarrowString(SidecarPath(output).wstring()) + "'");
+  }
+
+  string response = "{\"id\": " + id + ", \"ok\": true, \"output\": " +
+    JsonString(output.wstring()) + ", \"bytes\": " +
+    to_string(image.size());
+  for (size_t i = 0; i < warnings.size(); i++)
+    response += (i ? ", " : ", \"warnings\": [") +
+      JsonString(WideString(warnings[i]));
+  return response + (warnings.empty() ? "}" : "]}");
+}
+
+// A request that throws (e.g. bad_alloc) is answered like any other failure
+// instead of taking the server down
+string ServeRequest(const string &line, SourceCache &sources) {
+  string id = "null";
+  try {
+    map<string, JsonField> fields;
+    if (!JsonReader(line).Object(fields))
+      return ServeError(id, "malformed request, expected a JSON object");
+
+    if (fields.count("id"))
+      id = fields["id"].raw;
+    fields.erase("id");
+    return ServeBuild(id, fields, sources);
+  }
+  catch (const exception &e) {
+    return ServeError(id, string("request failed: ") + e.what());
+  }
+}
+
+
+// --------------------------------- Server -------------------------------- //
+int Serve() {
+  SourceCache         sources;
+
+  mutex               lock;
+  condition_variable  ready;
+  deque<string>       requests;
+  bool                closed = false;
+  mutex               output;
+
+  auto work = [&] {
+    while (true) {
+      string line;
+      {
+        unique_lock<mutex> guard(lock);
+        ready.wait(guard, [&] { return closed || !requests.empty(); });
+        if (requests.empty())
+          return;
+        line = move(requests.front());
+        requests.pop_front();
+      }
+
+      string response = ServeRequest(line, sources);
+      lock_guard<mutex> guard(output);
+      cout << response << endl;
+    }
+  };
+
+  vector<thread> workers;
+  unsigned count = max(1u, thread::hardware_concurrency());
+  for (unsigned i = 0; i < count; i++)
+    workers.emplace_back(work);
+
+  string line;
+  while (getline(cin, line)) {
+    if (line.find_first_not_of(" \t\r") == string::npos)
+      continue;
+    lock_guard<mutex> guard(lock);
+    requests.push_back(move(line));
+    ready.notify_one();
+  }
+
+  {
+    lock_guard<mutex> guard(lock);
+    closed = true;
+  }
+  ready.notify_all();
+  for (thread &worker : workers)
+    worker.join();
+  return 0;
+}
+
+// ------------------------------------------------------------------------- //
+#endif  // SERVE_FUNCTIONS_H
@@ -0,0 +1,125 @@
+// ------------------------------------------------------------------------- //
+// Shim Arguments                                                            //
+// ------------------------------------------------------------------------- //
+/**@file    SHIM_ARGUMENTS.H
+ * @brief   Takes the --shim flags out of a shim's command line
+ * @date    10/16/2026
+ *
+ * -------------------------------------------------------------------------
+ * What a shim does with its command line before anything else, shared with
+ * test/bench_arguments.cpp so the benchmark times exactly this. Most
+ * launches carry no --shim flags, in which case the arguments go to the
+ * target untouched, without parsing.
+ *
+ * Defines the following:
+ *
+ *  GetShimArg
+ *      takes a --shim switch, matched by one letter (--shim-Wait, --shim-W,
+ *      --shimgen-wait, ...)
+ *
+ *  ReadShimArguments
+ *      takes every --shim flag out of a command line, leaving the arguments
+ *      for the target
+ *
+ * -------------------------------------------------------------------------
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ * ------------------------------------------------------------------------- */
+
+#ifndef SHIM_ARGUMENTS_H
+#define SHIM_ARGUMENTS_H
+
+// ------------------------------------------------------------------------- //
+#include <string>
+#include <string_view>
+#include <cwchar>
+#include <get_argument.h>
+
+#define SHIM_ARG_PREFIX L"--shim"
+
+using namespace std;
+
+// The --shim flags of one launch: overrides are empty and switches FALSE
+// unless given
+struct ShimArguments {
+  wstring   wdType;
+  wstring   wdPath;
+  wstring   timeout;
+  wstring   timeoutGrace;
+  wstring   powerThrottling;
+  wstring   memoryPriority;
+  wstring   ioPriority;
+  wstring   tee;
+  wstring   stats;
+  wstring   responseFile;
+  bool      log     = false;
+  bool      wait    = false;
+  bool      exit    = false;
+  bool      gui     = false;
+  bool      noop    = false;
+  bool      help    = false;            // any other --shim flag
+  wstring   callingArgs;                // the rest, for the target
+};
+
+
+// Matches --shim<anything>-<LETTER><anything>, without building the pattern
+// on the heap
+bool GetShimArg(ArgumentList &args, wchar_t letter) {
+  wchar_t pattern[] = SHIM_ARG_PREFIX L"[a-z]*-?[a-z]*";
+  *wcschr(pattern, L'?') = letter;
+  return GetArgument(args, pattern);
+}
+
+
+/**@brief  Takes the --shim flags out of a command line
+ *
+ * @param  LINE:    the shim's command line, i.e. GetCommandLineW()
+ * @param  SHIM:    receives the flags and the arguments left for the target
+ */
+void ReadShimArguments(wstring_view line, ShimArguments &shim) {
+  wstring_view argTail = ArgumentTail(line);
+  if (!ContainsPrefix(argTail, SHIM_ARG_PREFIX)) {
+    shim.callingArgs = argTail;
+    return;
+  }
+
+  ArgumentList arg_list = ParseArguments(argTail);
+
+  // Valued arguments first, otherwise e.g. --shim-WdType would be taken as
+  // --shim-Wait by the single letter matching below
+  GetArgument(arg_list, L"--shim-wdtype", shim.wdType);
+  GetArgument(arg_list, L"--shim-wdpath", shim.wdPath);
+  GetArgument(arg_list, L"--shim-timeout", shim.timeout);
+  GetArgument(arg_list, L"--shim-timeoutgrace", shim.timeoutGrace);
+  GetArgument(arg_list, L"--shim-powerthrottling", shim.powerThrottling);
+  GetArgument(arg_list, L"--shim-memorypriority", shim.memoryPriority);
+  GetArgument(arg_list, L"--shim-iopriority", shim.ioPriority);
+  GetArgument(arg_list, L"--shim-tee", shim.tee);
+  GetArgument(arg_list, L"--shim-stats", shim.stats);
+  GetArgument(arg_list, L"--shim-responsefile", shim.responseFile);
+
+  shim.log  = GetShimArg(arg_list, L'l');
+  shim.wait = GetShimArg(arg_list, L'w');
+  shim.exit = GetShimArg(arg_list, L'e');
+  shim.gui  = GetShimArg(arg_list, L'g');
+  shim.noop = GetShimArg(arg_list, L'n');
+
+  // Any argument still starting with "--shim" asks for the help
+  shim.help = GetArgument(arg_list, SHIM_ARG_PREFIX L".*");
+
+  // Any arguments left, save to pass to parent executable
+  shim.callingArgs = CollapseArguments(arg_list);
+}
+
+// ------------------------------------------------------------------------- //
+#endif  // SHIM_ARGUMENTS_H
@@ -0,0 +1,168 @@
+/* ------------------------------------------------------------------------- */
+/* Shim Builder Library                                                      */
+/* ------------------------------------------------------------------------- */
+/**@file    SHIM_BUILDER.H
+ * @brief   C interface for building shims in memory
+ * @date    10/16/2026
+ *
+ * -------------------------------------------------------------------------
+ * Builds the same shim as SHIM_EXEC.EXE without a process, a temporary file
+ * or any file written at all: the shim is returned in the caller's buffer.
+ * Builds share nothing, so any number may run at once on different threads.
+ *
+ * Link against SHIM_BUILDER.LIB and ship SHIM_BUILDER.DLL (define
+ * SHIM_BUILDER_SHARED before including this), or link the static
+ * SHIM_BUILDER_STATIC.LIB. The DLL carries the shim templates; with the
+ * static library they are taken from the SHIM_TEMPLATES store (see
+ * TEMPLATE_STORE.H) or the SHIM_CONSOLE / SHIM_GUI RCDATA resources of the
+ * linking module, unless passed in the configuration.
+ * Templates for other architectures are SHIM_<TYPE>_<ARCH> (X86, X64 or
+ * ARM64); the shim gets the one matching its target if it was built.
+ *
+ *      ShimBuildConfig config = {sizeof(config)};
+ *      config.path = L"C:\\tools\\app.exe";
+ *      size_t size = 0;
+ *      ShimBuild(&config, NULL, 0, NULL, &size);      // SHIM_BUILD_TOO_SMALL
+ *      void *shim = malloc(size);
+ *      int result = ShimBuild(&config, NULL, 0, shim, &size);
+ *
+ * The ABI is stable: fields are only ever appended to ShimBuildConfig and
+ * the builder reads no further than the SIZE the caller set.
+ *
+ * The same configuration, source and builder always give the same bytes, so
+ * shims can be compared and cached by their hash.
+ *
+ * With SETTINGS set to SIDECAR only the target path is embedded; the rest
+ * goes into the <shim>.shim sidecar the caller writes (see SIDECAR.H). Such
+ * a shim is the same for any settings, so changing them later leaves it be.
+ *
+ * -------------------------------------------------------------------------
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ * ------------------------------------------------------------------------- */
+
+#ifndef SHIM_BUILDER_H
+#define SHIM_BUILDER_H
+
+/* ------------------------------------------------------------------------- */
+#include <stddef.h>
+#include <wchar.h>
+
+#if defined(SHIM_BUILDER_DLL)
+#define SHIM_BUILDER_API  __declspec(dllexport)
+#elif defined(SHIM_BUILDER_SHARED)
+#define SHIM_BUILDER_API  __declspec(dllimport)
+#else
+#define SHIM_BUILDER_API
+#endif
+
+#define SHIM_BUILDER_CALL __cdecl
+
+/* Characters reserved for the target path (and working directory) so shims
+ * can be retargeted in place later */
+#define SHIM_BUILD_PATH_RESERVE     260
+
+/* Results */
+#define SHIM_BUILD_OK               0
+#define SHIM_BUILD_TOO_SMALL        1   /* SIZE now holds what is needed   */
+#define SHIM_BUILD_INVALID_CONFIG   2   /* missing PATH or a bad setting   */
+#define SHIM_BUILD_NO_SOURCE        3   /* PATH could not be read          */
+#define SHIM_BUILD_NO_TEMPLATE      4   /* no template for the shim type   */
+#define SHIM_BUILD_BAD_TEMPLATE     5   /* template is not a usable image  */
+#define SHIM_BUILD_NO_MEMORY        6
+#define SHIM_BUILD_FAILED           7
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Every setting is a string exactly as given to SHIM_EXEC.EXE (e.g. "GUI",
+ * "30", "0xF"); NULL or empty leaves it unset. */
+typedef struct ShimBuildConfig {
+  size_t          size;             /* sizeof(ShimBuildConfig)            */
+  const wchar_t   *path;            /* [REQUIRED] full path of the target */
+  const wchar_t   *type;            /* CONSOLE or GUI; default from PATH  */
+  const wchar_t   *args;            /* --command                          */
+  const wchar_t   *wdType;          /* --wd-type                          */
+  const wchar_t   *wdPath;          /* --wd-path                          */
+  const wchar_t   *timeout;         /* --timeout                          */
+  const wchar_t   *timeoutGrace;    /* --timeout-grace                    */
+  const wchar_t   *memoryLimit;     /* --memory-limit                     */
+  const wchar_t   *jobMemoryLimit;  /* --job-memory-limit                 */
+  const wchar_t   *processLimit;    /* --process-limit                    */
+  const wchar_t   *cpuRate;         /* --cpu-rate                         */
+  const wchar_t   *priority;        /* --priority                         */
+  const wchar_t   *affinity;        /* --affinity                         */
+  const wchar_t   *powerThrottling; /* --power-throttling                 */
+  const wchar_t   *memoryPriority;  /* --memory-priority                  */
+  const wchar_t   *ioPriority;      /* --io-priority                      */
+  const wchar_t   *tee;             /* --tee                              */
+  const wchar_t   *jobStats;        /* --job-stats                        */
+  const wchar_t   *journal;         /* --journal                          */
+  const void      *templateImage;   /* shim template; NULL for built in   */
+  size_t          templateSize;
+  const wchar_t   *sourceDateEpoch; /* --source-date-epoch                */
+  const wchar_t   *interpreter;     /* --interpreter, for scripts         */
+  const wchar_t   *responseFile;    /* --response-file                    */
+  const wchar_t   *arch;            /* --arch; default TARGET             */
+  const wchar_t   *settings;        /* --sidecar: SIDECAR or EMBED        */
+} ShimBuildConfig;
+
+/**@brief  Builds a shim
+ *
+ * @param  CONFIG:      the shim's settings
+ * @param  SOURCE:      image of the target to take icons and version info
+ *                      from, or NULL to read it from CONFIG->PATH
+ * @param  SOURCE_SIZE: its size in bytes
+ * @param  OUTPUT:      receives the shim, may be NULL to query the size
+ * @param  SIZE:        in, the size of OUTPUT; out, the size of the shim
+ *
+ * @return SHIM_BUILD_OK or one of the other SHIM_BUILD_* results
+ */
+SHIM_BUILDER_API int SHIM_BUILDER_CALL
+ShimBuild(const ShimBuildConfig *config,
+          const void *source, size_t source_size,
+          void *output, size_t *size);
+
+/* Short description of a SHIM_BUILD_* result */
+SHIM_BUILDER_API const char * SHIM_BUILDER_CALL
+ShimBuildMessage(int result);
+
+#ifdef __cplusplus
+}
+
+// ------------------------------------------------------------------------- //
+#include <vector>
+
+// First guess at the size of a shim, big enough for nearly all of them
+#define SHIM_BUILD_SIZE_GUESS       (1 << 20)
+
+// Builds into SHIM, growing it if the guess was too small
+inline int ShimBuild(const ShimBuildConfig &config,
+                     const void *source, size_t source_size,
+                     std::vector<unsigned char> &shim) {
+  shim.resize(SHIM_BUILD_SIZE_GUESS);
+  size_t size = shim.size();
+  int result = ShimBuild(&config, source, source_size, shim.data(), &size);
+  if (result == SHIM_BUILD_TOO_SMALL) {
+    shim.resize(size);
+    result = ShimBuild(&config, source, source_size, shim.data(), &size);
+  }
+  if (result == SHIM_BUILD_OK)
+    shim.resize(size);
+  return result;
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+#endif  /* SHIM_BUILDER_H */
@@ -0,0 +1,382 @@
+// ------------------------------------------------------------------------- //
+// Sidecar Settings                                                          //
+// ------------------------------------------------------------------------- //
+/**@file    SIDECAR.H
+ * @brief   Reads and writes the <shim>.shim settings file next to a shim
+ * @date    10/16/2026
+ *
+ * -------------------------------------------------------------------------
+ * Changing a setting embedded in a shim rewrites the executable, which has
+ * antivirus scan it and reputation checks start over on its next launch. A
+ * shim instead reads its settings from a text file next to it, named like it
+ * with the extension .shim, before falling back to the embedded ones. The
+ * format is Scoop's, so its sidecars work as they are:
+ *
+ *      path = "C:\Tools\app\1.2\app.exe"
+ *      args = --profile default
+ *      timeout = 30
+ *
+ * One setting per line as KEY = VALUE. Keys are those of SHIM_EXEC without
+ * the dashes (wd_type, memory_limit, ...; dashes work too) and are not case
+ * sensitive. Values run to the end of the line, and all but ARGS may be
+ * quoted. Empty lines, lines starting with # or ; and unknown keys are
+ * skipped. The file is UTF-8, with or without a byte order mark.
+ *
+ * Defines the following:
+ *
+ *  SidecarPath
+ *      the sidecar of a shim
+ *
+ *  ParseSidecar / FormatSidecar
+ *      text to settings (by resource name, e.g. SHIM_PATH) and back
+ *
+ *  RewriteSidecar
+ *      changes some settings of a sidecar, keeping the rest of its text
+ *
+ *  ReadSidecar / WriteSidecar
+ *      the same on files; a shim without a sidecar costs one attribute query
+ *
+ *  UpdateSidecar
+ *      writes the sidecar of a shim just built (ShimBuildConfig::settings is
+ *      SIDECAR), or removes an old one that would override its settings
+ *
+ * -------------------------------------------------------------------------
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ * ------------------------------------------------------------------------- */
+
+#ifndef SIDECAR_H
+#define SIDECAR_H
+
+// ------------------------------------------------------------------------- //
+#include <windows.h>
+#include <string>
+#include <string_view>
+#include <cctype>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <filesystem>
+#include <utility_functions.h>
+#include <shim_builder.h>
+
+#define SIDECAR_EXTENSION   L".shim"
+// Anything larger is not a sidecar written by hand or by SHIM_EXEC
+#define SIDECAR_MAX_SIZE    (64 * 1024)
+
+using namespace std;
+
+// Keys in the order they are written, and the resources they stand for
+struct SidecarKey {
+  const char  *key;
+  const char  *resource;
+};
+
+const SidecarKey SIDECAR_KEYS[] = {
+  {"path",              "SHIM_PATH"},
+  {"args",              "SHIM_ARGS"},
+  {"interpreter",       "SHIM_INTERPRETER"},
+  {"wd_type",           "WD_TYPE"},
+  {"wd_path",           "WD_PATH"},
+  {"timeout",           "SHIM_TIMEOUT"},
+  {"timeout_grace",     "SHIM_TIMEOUT_GRACE"},
+  {"memory_limit",      "LIMIT_PROCESS_MEMORY"},
+  {"job_memory_limit",  "LIMIT_JOB_MEMORY"},
+  {"process_limit",     "LIMIT_PROCESSES"},
+  {"cpu_rate",          "LIMIT_CPU_RATE"},
+  {"priority",          "LIMIT_PRIORITY"},
+  {"affinity",          "LIMIT_AFFINITY"},
+  {"power_throttling",  "QOS_POWER_THROTTLING"},
+  {"memory_priority",   "QOS_MEMORY_PRIORITY"},
+  {"io_priority",       "QOS_IO_PRIORITY"},
+  {"tee",               "SHIM_TEE"},
+  {"job_stats",         "SHIM_STATS"},
+  {"journal",           "SHIM_JOURNAL"},
+  {"response_file",     "SHIM_RESPONSE_FILE"},
+};
+
+
+// ------------------------------- Parsing --------------------------------- //
+// <shim>.shim for <shim>.exe
+inline filesystem::path SidecarPath(const filesystem::path &shim) {
+  filesystem::path sidecar = shim;
+  return sidecar.replace_extension(SIDECAR_EXTENSION);
+}
+
+inline string_view SidecarTrim(string_view text) {
+  size_t start = text.find_first_not_of(" \t\r");
+  if (start == string_view::npos)
+    return string_view();
+  size_t end = text.find_last_not_of(" \t\r");
+  return text.substr(start, end - start + 1);
+}
+
+// The known key of LINE and its VALUE, nullptr for empty lines, comments,
+// lines without = and unknown keys
+inline const SidecarKey *SidecarLineKey(string_view line, string_view &value) {
+  line = SidecarTrim(line);
+  size_t equal = line.find('=');
+  if (line.empty() || line[0] == '#' || line[0] == ';' ||
+      equal == string_view::npos)
+    return nullptr;
+
+  string key(SidecarTrim(line.substr(0, equal)));
+  for (char &c : key)
+    c = c == '-' ? '_' : (char)tolower((unsigned char)c);
+  value = SidecarTrim(line.substr(equal + 1));
+
+  for (const SidecarKey &known : SIDECAR_KEYS)
+    if (key == known.key)
+      return &known;
+  return nullptr;
+}
+
+/**@brief  Reads the settings of a sidecar
+ *
+ * @param  TEXT:      its contents (UTF-8)
+ * @param  SETTINGS:  receives them by resource name (e.g. SHIM_PATH); later
+ *                    lines win over earlier ones with the same key
+ *
+ * @return number of settings read
+ */
+inline size_t ParseSidecar(string_view text, map<string, wstring> &settings) {
+  if (text.substr(0, 3) == "\xEF\xBB\xBF")
+    text.remove_prefix(3);
+
+  size_t count = 0;
+  while (!text.empty()) {
+    size_t      eol  = text.find('\n');
+    string_view line = text.substr(0, eol);
+    text.remove_prefix(eol == string_view::npos ? text.size() : eol + 1);
+
+    string_view       value;
+    const SidecarKey *known = SidecarLineKey(line, value);
+    if (!known)
+      continue;
+    // ARGS is handed on as it is, quotes included
+    if (string_view(known->key) != "args" && value.size() >= 2 &&
+        value.front() == '"' && value.back() == '"')
+      value = value.substr(1, value.size() - 2);
+    settings[known->resource] = WideString(string(value));
+    count++;
+  }
+  return count;
+}
+
+// "KEY = VALUE" for a setting, FALSE if VALUE does not fit on one line
+inline bool SidecarLine(const SidecarKey &known, const wstring &value,
+                        string &line) {
+  if (value.find_first_of(L"\r\n") != wstring::npos)
+    return false;
+
+  line = NarrowString(value);
+  if (string_view(known.key) == "path")
+    line = "\"" + line + "\"";
+  line = string(known.key) + " = " + line;
+  return true;
+}
+
+/**@brief  Sidecar text of some settings
+ *
+ * @param  SETTINGS:  by resource name; empty ones are skipped
+ * @param  TEXT:      set to the sidecar
+ *
+ * @return FALSE if a value holds a line break, which a sidecar cannot carry
+ */
+inline bool FormatSidecar(const map<string, wstring> &settings, string &text) {
+  text.clear();
+  for (const SidecarKey &known : SIDECAR_KEYS) {
+    auto setting = settings.find(known.resource);
+    if (setting == settings.end() || setting->second.empty())
+      continue;
+
+    string line;
+    if (!SidecarLine(known, setting->second, line))
+      return false;
+    text += line + "\r\n";
+  }
+  return true;
+}
+
+/**@brief  Changes settings of a sidecar and nothing else
+ *
+ * Lines of the changed keys (all of them, if a key repeats) are replaced in
+ * place; comments, empty lines, unknown keys and line endings are kept as
+ * they are. Changed keys the sidecar lacks are added at its end.
+ *
+ * @param  TEXT:      the sidecar
+ * @param  CHANGES:   new values by resource name (e.g. SHIM_PATH)
+ * @param  OUTPUT:    set to the changed sidecar
+ *
+ * @return FALSE if a value holds a line break
+ */
+inline bool RewriteSidecar(string_view text,
+                           const map<string, wstring> &changes,
+                           string &output) {
+  output.clear();
+  if (text.substr(0, 3) == "\xEF\xBB\xBF") {
+    output = text.substr(0, 3);
+    text.remove_prefix(3);
+  }
+
+  map<string, wstring> missing = changes;
+  while (!text.empty()) {
+    // The line, and its line ending (if any) as it is
+    size_t      end  = min(text.find('\n'), text.size());
+    size_t      next = end < text.size() ? end + 1 : end;
+    if (end && text[end - 1] == '\r')
+      end--;
+    string_view line = text.substr(0, end);
+    string_view eol  = text.substr(end, next - end);
+    text.remove_prefix(next);
+
+    string_view       value;
+    const SidecarKey *known = SidecarLineKey(line, value);
+    auto change = known ? changes.find(known->resource) : changes.end();
+    string replaced;
+    if (change == changes.end())
+      output += line;
+    else if (!SidecarLine(*known, change->second, replaced))
+      return false;
+    else {
+      output += replaced;
+      missing.erase(known->resource);
+    }
+    output += eol;
+  }
+
+  for (const SidecarKey &known : SIDECAR_KEYS) {
+    auto change = missing.find(known.resource);
+    if (change == missing.end())
+      continue;
+
+    string line;
+    if (!SidecarLine(known, change->second, line))
+      return false;
+    if (!output.empty() && output.back() != '\n')
+      output += "\r\n";
+    output += line + "\r\n";
+  }
+  return true;
+}
+
+
+// -------------------------------- Files ---------------------------------- //
+/**@brief  Reads the text of a sidecar
+ *
+ * @param  SIDECAR:   its path
+ * @param  TEXT:      set to its contents
+ *
+ * @return FALSE if there is no sidecar (after one attribute query) or it
+ *         could not be read
+ */
+inline bool ReadSidecarText(const filesystem::path &sidecar, string &text) {
+  WIN32_FILE_ATTRIBUTE_DATA data = {};
+  if (!GetFileAttributesExW(sidecar.c_str(), GetFileExInfoStandard, &data) ||
+      (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ||
+      data.nFileSizeHigh || data.nFileSizeLow > SIDECAR_MAX_SIZE)
+    return false;
+
+  vector<BYTE> bytes;
+  if (!ReadFileData(sidecar, bytes))
+    return false;
+  text.assign(bytes.begin(), bytes.end());
+  return true;
+}
+
+// Reads the settings of SIDECAR by resource name, as ReadSidecarText
+inline bool ReadSidecar(const filesystem::path &sidecar,
+                        map<string, wstring> &settings) {
+  string text;
+  if (!ReadSidecarText(sidecar, text))
+    return false;
+  ParseSidecar(text, settings);
+  return true;
+}
+
+// Writes TEXT as a copy that then replaces SIDECAR, so a shim starting
+// meanwhile reads either the old or the new one
+inline bool WriteSidecarText(const filesystem::path &sidecar,
+                             const string &text) {
+  filesystem::path temp = sidecar;
+  temp += L".tmp";
+  if (!WriteFileData(temp, vector<BYTE>(text.begin(), text.end())))
+    return false;
+  if (!MoveFileExW(temp.c_str(), sidecar.c_str(),
+                   MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+    DeleteFileW(temp.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Writes SETTINGS as a new sidecar, FALSE if one holds a line break
+inline bool WriteSidecar(const filesystem::path &sidecar,
+                         const map<string, wstring> &settings) {
+  string text;
+  return FormatSidecar(settings, text) && WriteSidecarText(sidecar, text);
+}
+
+// Settings of CONFIG by resource name, as a sidecar carries them
+inline map<string, wstring> SidecarSettings(const ShimBuildConfig &config) {
+  struct { const char *resource; const wchar_t *value; } fields[] = {
+    {"SHIM_PATH",             config.path},
+    {"SHIM_ARGS",             config.args},
+    {"SHIM_INTERPRETER",      config.interpreter},
+    {"WD_TYPE",               config.wdType},
+    {"WD_PATH",               config.wdPath},
+    {"SHIM_TIMEOUT",          config.timeout},
+    {"SHIM_TIMEOUT_GRACE",    config.timeoutGrace},
+    {"LIMIT_PROCESS_MEMORY",  config.memoryLimit},
+    {"LIMIT_JOB_MEMORY",      config.jobMemoryLimit},
+    {"LIMIT_PROCESSES",       config.processLimit},
+    {"LIMIT_CPU_RATE",        config.cpuRate},
+    {"LIMIT_PRIORITY",        config.priority},
+    {"LIMIT_AFFINITY",        config.affinity},
+    {"QOS_POWER_THROTTLING",  config.powerThrottling},
+    {"QOS_MEMORY_PRIORITY",   config.memoryPriority},
+    {"QOS_IO_PRIORITY",       config.ioPriority},
+    {"SHIM_TEE",              config.tee},
+    {"SHIM_STATS",            config.jobStats},
+    {"SHIM_JOURNAL",          config.journal},
+    {"SHIM_RESPONSE_FILE",    config.responseFile},
+  };
+
+  map<string, wstring> settings;
+  for (const auto &field : fields)
+    if (field.value && *field.value)
+      settings[field.resource] = field.value;
+  return settings;
+}
+
+/**@brief  Brings the sidecar of a shim in line with how it was built
+ *
+ * @param  SHIM:    the shim, already written
+ * @param  CONFIG:  what it was built with
+ *
+ * @return FALSE if the sidecar could not be written or removed
+ */
+inline bool UpdateSidecar(const filesystem::path &shim,
+                          const ShimBuildConfig &config) {
+  filesystem::path sidecar = SidecarPath(shim);
+  wstring settings = config.settings ? config.settings : L"";
+  UpperCase(settings);
+  if (settings == L"SIDECAR")
+    return WriteSidecar(sidecar, SidecarSettings(config));
+
+  return DeleteFileW(sidecar.c_str()) ||
+         GetLastError() == ERROR_FILE_NOT_FOUND;
+}
+
+// ------------------------------------------------------------------------- //
+#endif  // SIDECAR_H
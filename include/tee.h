@@ -0,0 +1,263 @@
+// ------------------------------------------------------------------------- //
+// Tee the Target's Output                                                   //
+// ------------------------------------------------------------------------- //
+/**@file    TEE.H
+ * @brief   Relays the target's stdout/stderr to the console and a file
+ * @date    10/16/2026
+ *
+ * -------------------------------------------------------------------------
+ * The target's stdout and stderr are connected to two pipes instead of the
+ * shim's own handles. A single thread keeps an overlapped read outstanding on
+ * each pipe, double buffered, so the target never waits on the shim while
+ * the previous chunk is written to the original handle and the tee file.
+ * Chunks are relayed in the order their reads complete, which keeps the two
+ * streams ordered as well as pipes allow.
+ *
+ * The pipes get random names and take local clients only, so no other
+ * process can guess them and connect first. rand_s needs _CRT_RAND_S, which
+ * the Makefile defines.
+ *
+ * -------------------------------------------------------------------------
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ * ------------------------------------------------------------------------- */
+
+#ifndef TEE_H
+#define TEE_H
+
+// ------------------------------------------------------------------------- //
+#include <windows.h>
+#include <stdlib.h>
+#include <cwchar>
+#include <string>
+#include <vector>
+
+#define TEE_BUFSIZE     (1 << 20)       // per read, two per stream
+#define TEE_DRAIN_MS    100             // idle time before giving up on EOF
+
+using namespace std;
+
+struct TeeStream {
+  HANDLE        pipe        = nullptr;  // shim's end, overlapped
+  HANDLE        child       = nullptr;  // target's end, inheritable
+  HANDLE        original    = nullptr;  // shim's own stdout / stderr
+  OVERLAPPED    overlapped  = {};
+  vector<char>  buffer[2];
+  int           current     = 0;
+  bool          reading     = false;
+};
+
+class Tee {
+public:
+  ~Tee() {
+    // A cancelled read still owns its buffer and OVERLAPPED until the
+    // cancellation completes, so wait for that before freeing either
+    for (TeeStream &stream : streams) {
+      if (stream.reading) {
+        DWORD bytes = 0;
+        CancelIoEx(stream.pipe, &stream.overlapped);
+        GetOverlappedResult(stream.pipe, &stream.overlapped, &bytes, TRUE);
+      }
+      closeHandle(stream.pipe);
+      closeHandle(stream.child);
+      closeHandle(stream.overlapped.hEvent);
+    }
+    closeHandle(file);
+  }
+
+  /**@brief  Creates the tee file and the two pipes
+   *
+   * @param  PATH:  file receiving a copy of everything the target prints
+   *
+   * @return TRUE if everything could be created
+   */
+  bool Open(const wstring &path) {
+    file = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                       CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      file = nullptr;
+      return false;
+    }
+
+    streams[0].original = GetStdHandle(STD_OUTPUT_HANDLE);
+    streams[1].original = GetStdHandle(STD_ERROR_HANDLE);
+
+    for (TeeStream &stream : streams)
+      if (!openPipe(stream))
+        return false;
+    return true;
+  }
+
+  HANDLE Output() const { return streams[0].child; }
+  HANDLE Error()  const { return streams[1].child; }
+
+  /**@brief  Closes the target's ends once it has inherited them
+   *
+   * Otherwise the pipes would never report EOF.
+   */
+  void CloseChildEnds() {
+    for (TeeStream &stream : streams)
+      closeHandle(stream.child);
+  }
+
+  /**@brief  Relays output until the target exits or the timeout expires
+   *
+   * Once the target has exited, whatever is still buffered is drained until
+   * the pipes report EOF or stay idle for TEE_DRAIN_MS (a grandchild may have
+   * inherited them and keep them open).
+   *
+   * @param  PROCESS:   the target
+   * @param  TIMEOUT:   milliseconds, or INFINITE
+   *
+   * @return WAIT_OBJECT_0 if the target exited, otherwise WAIT_TIMEOUT
+   */
+  DWORD Relay(HANDLE process, DWORD timeout) {
+    ULONGLONG deadline  = timeout == INFINITE ? 0 : GetTickCount64() + timeout;
+    bool exited         = false;
+
+    for (TeeStream &stream : streams)
+      if (!stream.reading && stream.pipe)
+        read(stream);
+
+    while (true) {
+      HANDLE    handles[3];
+      TeeStream *owners[2];
+      DWORD     count = 0;
+
+      for (TeeStream &stream : streams) {
+        if (stream.reading) {
+          owners[count]     = &stream;
+          handles[count++]  = stream.overlapped.hEvent;
+        }
+      }
+
+      if (count == 0 && exited)
+        return WAIT_OBJECT_0;
+      if (!exited)
+        handles[count] = process;
+
+      DWORD wait = exited ? TEE_DRAIN_MS : INFINITE;
+      if (!exited && deadline) {
+        ULONGLONG now = GetTickCount64();
+        if (now >= deadline)
+          return WAIT_TIMEOUT;
+        wait = (DWORD)(deadline - now);
+      }
+
+      DWORD result =
+        WaitForMultipleObjects(count + (exited ? 0 : 1), handles, FALSE, wait);
+
+      if (result == WAIT_TIMEOUT) {
+        if (exited)
+          return WAIT_OBJECT_0;
+        return WAIT_TIMEOUT;
+      }
+      if (result == WAIT_FAILED)
+        return exited ? WAIT_OBJECT_0 : WaitForSingleObject(process, wait);
+
+      DWORD index = result - WAIT_OBJECT_0;
+      if (index == count)
+        exited = true;
+      else
+        complete(*owners[index]);
+    }
+  }
+
+private:
+  TeeStream streams[2];
+  HANDLE    file = nullptr;
+
+  void closeHandle(HANDLE &handle) {
+    if (handle)
+      CloseHandle(handle);
+    handle = nullptr;
+  }
+
+  bool openPipe(TeeStream &stream) {
+    wchar_t random[33];
+    for (int i = 0; i < 4; i++) {
+      unsigned int value = 0;
+      if (rand_s(&value))
+        return false;
+      swprintf(random + 8 * i, 9, L"%08x", value);
+    }
+    wstring name = wstring(L"\\\\.\\pipe\\shim-tee-") + random;
+
+    stream.pipe = CreateNamedPipeW(
+        name.c_str(),
+        PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED |
+        FILE_FLAG_FIRST_PIPE_INSTANCE,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT |
+        PIPE_REJECT_REMOTE_CLIENTS,
+        1, TEE_BUFSIZE, TEE_BUFSIZE, 0, nullptr);
+    if (stream.pipe == INVALID_HANDLE_VALUE) {
+      stream.pipe = nullptr;
+      return false;
+    }
+
+    SECURITY_ATTRIBUTES inherit = {sizeof(inherit), nullptr, TRUE};
+    stream.child = CreateFileW(name.c_str(), GENERIC_WRITE, 0, &inherit,
+                               OPEN_EXISTING, 0, nullptr);
+    if (stream.child == INVALID_HANDLE_VALUE) {
+      stream.child = nullptr;
+      return false;
+    }
+
+    stream.overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    stream.buffer[0].resize(TEE_BUFSIZE);
+    stream.buffer[1].resize(TEE_BUFSIZE);
+    return stream.overlapped.hEvent != nullptr;
+  }
+
+  // Queue a read into the current buffer; completion signals the event
+  void read(TeeStream &stream) {
+    HANDLE event = stream.overlapped.hEvent;
+    stream.overlapped = {};
+    stream.overlapped.hEvent = event;
+
+    stream.reading =
+      ReadFile(stream.pipe, stream.buffer[stream.current].data(), TEE_BUFSIZE,
+               nullptr, &stream.overlapped) ||
+      GetLastError() == ERROR_IO_PENDING;
+  }
+
+  // Take the finished chunk, queue the next read into the other buffer right
+  // away, then write the chunk out
+  void complete(TeeStream &stream) {
+    DWORD bytes = 0;
+    stream.reading = false;
+    if (!GetOverlappedResult(stream.pipe, &stream.overlapped, &bytes, FALSE))
+      return;                                   // EOF (broken pipe)
+
+    const char *chunk = stream.buffer[stream.current].data();
+    stream.current ^= 1;
+    read(stream);
+
+    write(stream.original, chunk, bytes);
+    write(file, chunk, bytes);
+  }
+
+  void write(HANDLE handle, const char *data, DWORD bytes) {
+    if (!handle || handle == INVALID_HANDLE_VALUE)
+      return;
+
+    DWORD written = 0;
+    while (bytes > 0 && WriteFile(handle, data, bytes, &written, nullptr)) {
+      data  += written;
+      bytes -= written;
+    }
+  }
+};
+
+// ------------------------------------------------------------------------- //
+#endif  // TEE_H
@@ -0,0 +1,337 @@
+// ------------------------------------------------------------------------- //
+// Template Store                                                            //
+// ------------------------------------------------------------------------- //
+/**@file    TEMPLATE_STORE.H
+ * @brief   Reads the shim templates from one compressed resource
+ * @date    10/16/2026
+ *
+ * -------------------------------------------------------------------------
+ * Every variant of the shim template (subsystem, architecture) would add its
+ * full size to SHIM_EXEC.EXE and SHIM_BUILDER.DLL as a raw RCDATA resource.
+ * Instead TOOLS\PACK_TEMPLATES.CPP packs them into the SHIM_TEMPLATES
+ * resource at build time:
+ *
+ *      header      magic, version, number of variants and blobs
+ *      variants    name (e.g. SHIM_CONSOLE_ARM64), blob, patch and size
+ *      blobs       algorithm, offset, stored and original size
+ *      data        the compressed blobs and the patches
+ *
+ * A blob is a template compressed with the Windows compression API (XPRESS
+ * with Huffman coding, which decompresses at several hundred MB/s). The
+ * console and GUI templates of an architecture are linked from the same
+ * object and differ in a handful of bytes, so only one of them is a blob;
+ * the other is that blob plus a patch: runs of {offset, length, bytes}.
+ *
+ * Defines the following:
+ *
+ *  TemplateStoreOpen
+ *      checks a store and indexes it (bounds checked throughout)
+ *
+ *  TemplateStoreRead
+ *      decompresses and patches one variant
+ *
+ *  TemplateImage
+ *      a variant from a module's store, or from a plain RCDATA resource of
+ *      that name, decompressed at most once per process and kept
+ *
+ *  ImageId / TemplateId
+ *      build ID of a template image (FNV-1a of its bytes, in hex)
+ *
+ * -------------------------------------------------------------------------
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ * ------------------------------------------------------------------------- */
+
+#ifndef TEMPLATE_STORE_H
+#define TEMPLATE_STORE_H
+
+// ------------------------------------------------------------------------- //
+#include <windows.h>
+#include <compressapi.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstring>
+
+#pragma comment(lib, "CABINET.LIB")
+
+#define TEMPLATE_STORE            "SHIM_TEMPLATES"
+#define TEMPLATE_STORE_MAGIC      0x53544853        // "SHTS"
+#define TEMPLATE_STORE_VERSION    1
+#define TEMPLATE_STORE_NAME       32                // characters, with NUL
+#define TEMPLATE_STORE_ALGORITHM  COMPRESS_ALGORITHM_XPRESS_HUFF
+// Templates are a few hundred KB; a larger size is a corrupt store
+#define TEMPLATE_STORE_MAX_IMAGE  (16 * 1024 * 1024)
+
+using namespace std;
+
+struct TemplateStoreHeader {
+  DWORD     magic;
+  DWORD     version;
+  DWORD     variants;
+  DWORD     blobs;
+};
+
+struct TemplateStoreVariant {
+  char      name[TEMPLATE_STORE_NAME];
+  DWORD     blob;
+  DWORD     patch;                    // offset of its patch, if PATCH_SIZE
+  DWORD     patchSize;
+  DWORD     size;
+};
+
+struct TemplateStoreBlob {
+  DWORD     algorithm;                // COMPRESS_ALGORITHM_*
+  DWORD     offset;
+  DWORD     stored;                   // compressed size
+  DWORD     size;
+};
+
+// A store in memory, e.g. a locked resource, which must stay loaded
+struct TemplateStoreView {
+  const BYTE                  *data = nullptr;
+  size_t                      size = 0;
+  const TemplateStoreHeader   *header = nullptr;
+  const TemplateStoreVariant  *variants = nullptr;
+  const TemplateStoreBlob     *blobs = nullptr;
+};
+
+
+// ------------------------------ Reading ---------------------------------- //
+inline bool TemplateStoreInRange(size_t size, ULONGLONG offset,
+                                 ULONGLONG length) {
+  return offset <= size && length <= size - offset;
+}
+
+/**@brief  Checks and indexes a template store
+ *
+ * @param  DATA:    the SHIM_TEMPLATES resource
+ * @param  SIZE:    its size in bytes
+ * @param  STORE:   set to the index
+ *
+ * @return TRUE if DATA is a store this version can read
+ */
+inline bool TemplateStoreOpen(const BYTE *data, size_t size,
+                              TemplateStoreView &store) {
+  if (!data || size < sizeof(TemplateStoreHeader))
+    return false;
+
+  const TemplateStoreHeader *header = (const TemplateStoreHeader *)data;
+  ULONGLONG variants = sizeof(TemplateStoreHeader);
+  ULONGLONG blobs    = variants +
+    (ULONGLONG)header->variants * sizeof(TemplateStoreVariant);
+  if (header->magic != TEMPLATE_STORE_MAGIC ||
+      header->version != TEMPLATE_STORE_VERSION ||
+      !TemplateStoreInRange(size, variants, blobs - variants) ||
+      !TemplateStoreInRange(size, blobs, (ULONGLONG)header->blobs *
+                                         sizeof(TemplateStoreBlob)))
+    return false;
+
+  store.data      = data;
+  store.size      = size;
+  store.header    = header;
+  store.variants  = (const TemplateStoreVariant *)(data + variants);
+  store.blobs     = (const TemplateStoreBlob *)(data + blobs);
+
+  // Sizes are checked here, before anything is allocated for them; a patch
+  // keeps the size of its blob
+  for (DWORD i = 0; i < header->blobs; i++) {
+    const TemplateStoreBlob &blob = store.blobs[i];
+    if (blob.algorithm != TEMPLATE_STORE_ALGORITHM ||
+        blob.size > TEMPLATE_STORE_MAX_IMAGE ||
+        !TemplateStoreInRange(size, blob.offset, blob.stored))
+      return false;
+  }
+  for (DWORD i = 0; i < header->variants; i++) {
+    const TemplateStoreVariant &variant = store.variants[i];
+    if (!memchr(variant.name, 0, TEMPLATE_STORE_NAME) ||
+        variant.blob >= header->blobs ||
+        variant.size != store.blobs[variant.blob].size ||
+        !TemplateStoreInRange(size, variant.patch, variant.patchSize))
+      return false;
+  }
+  return true;
+}
+
+// The variant called NAME, nullptr if the store has none
+inline const TemplateStoreVariant *TemplateStoreFind(
+    const TemplateStoreView &store, const string &name) {
+  for (DWORD i = 0; i < store.header->variants; i++)
+    if (name == store.variants[i].name)
+      return &store.variants[i];
+  return nullptr;
+}
+
+// Decompresses blob I into IMAGE
+inline bool TemplateStoreBlobImage(const TemplateStoreView &store, DWORD i,
+                                   vector<BYTE> &image) {
+  const TemplateStoreBlob &blob = store.blobs[i];
+  DECOMPRESSOR_HANDLE decompressor = nullptr;
+  if (!CreateDecompressor(blob.algorithm, nullptr, &decompressor))
+    return false;
+
+  image.resize(blob.size);
+  SIZE_T size = 0;
+  bool ok = Decompress(decompressor, store.data + blob.offset, blob.stored,
+                       image.data(), image.size(), &size) &&
+            size == blob.size;
+  CloseDecompressor(decompressor);
+  return ok;
+}
+
+// Applies the patch of VARIANT to IMAGE, its blob
+inline bool TemplateStorePatch(const TemplateStoreView &store,
+                               const TemplateStoreVariant &variant,
+                               vector<BYTE> &image) {
+  if (image.size() != variant.size)
+    return false;
+
+  const BYTE *patch = store.data + variant.patch;
+  size_t      pos   = 0;
+  while (pos < variant.patchSize) {
+    if (variant.patchSize - pos < 2 * sizeof(DWORD))
+      return false;
+    DWORD offset, length;
+    memcpy(&offset, patch + pos, sizeof(DWORD));
+    memcpy(&length, patch + pos + sizeof(DWORD), sizeof(DWORD));
+    pos += 2 * sizeof(DWORD);
+
+    if (!TemplateStoreInRange(variant.patchSize, pos, length) ||
+        !TemplateStoreInRange(image.size(), offset, length))
+      return false;
+    memcpy(image.data() + offset, patch + pos, length);
+    pos += length;
+  }
+  return true;
+}
+
+/**@brief  Reads one variant of a store, uncached
+ *
+ * @param  STORE:   from TemplateStoreOpen
+ * @param  NAME:    variant, e.g. SHIM_CONSOLE or SHIM_GUI_ARM64
+ * @param  IMAGE:   set to the template
+ *
+ * @return TRUE if the variant is in STORE and could be read
+ */
+inline bool TemplateStoreRead(const TemplateStoreView &store,
+                              const string &name, vector<BYTE> &image) {
+  const TemplateStoreVariant *variant = TemplateStoreFind(store, name);
+  return variant && TemplateStoreBlobImage(store, variant->blob, image) &&
+         TemplateStorePatch(store, *variant, image);
+}
+
+
+// ------------------------------- Modules --------------------------------- //
+// The store in the resources of MODULE (nullptr for the executable)
+inline bool TemplateStoreOf(HMODULE module, TemplateStoreView &store) {
+  HRSRC resource = FindResource(module, TEMPLATE_STORE, RT_RCDATA);
+  if (!resource)
+    return false;
+  const BYTE *data = (const BYTE *)LockResource(LoadResource(module, resource));
+  return TemplateStoreOpen(data, SizeofResource(module, resource), store);
+}
+
+/**@brief  A shim template of a module
+ *
+ * Taken from the module's SHIM_TEMPLATES store, else from a plain RCDATA
+ * resource named VARIANT (as modules linking the static builder library may
+ * carry). Each blob and variant is decompressed once per process and kept,
+ * so building many shims costs one decompression; any number of threads may
+ * ask at once. Failures are not kept, so a later call tries again.
+ *
+ * @param  MODULE:  module with the templates, nullptr for the executable
+ * @param  VARIANT: e.g. SHIM_CONSOLE or SHIM_GUI_ARM64
+ *
+ * @return the template, nullptr if MODULE has no such variant
+ */
+inline shared_ptr<const vector<BYTE>> TemplateImage(HMODULE module,
+                                                    const string &variant) {
+  typedef shared_ptr<const vector<BYTE>> Image;
+  static mutex                        lock;
+  static map<pair<HMODULE, string>, Image>  variants;
+  static map<pair<HMODULE, DWORD>, Image>   blobs;
+
+  if (!module)
+    module = GetModuleHandleW(nullptr);
+  lock_guard<mutex> guard(lock);
+  auto cached = variants.find({module, variant});
+  if (cached != variants.end())
+    return cached->second;
+
+  Image image;
+  TemplateStoreView store;
+  const TemplateStoreVariant *found = nullptr;
+  if (TemplateStoreOf(module, store) &&
+      (found = TemplateStoreFind(store, variant))) {
+    Image blob;
+    auto cachedBlob = blobs.find({module, found->blob});
+    if (cachedBlob != blobs.end())
+      blob = cachedBlob->second;
+    else {
+      auto data = make_shared<vector<BYTE>>();
+      if (!TemplateStoreBlobImage(store, found->blob, *data))
+        return nullptr;
+      blob = blobs[{module, found->blob}] = data;
+    }
+
+    if (!found->patchSize)
+      image = blob;
+    else {
+      auto data = make_shared<vector<BYTE>>(*blob);
+      if (!TemplateStorePatch(store, *found, *data))
+        return nullptr;
+      image = data;
+    }
+  }
+  else if (HRSRC resource = FindResource(module, variant.c_str(),
+                                         RT_RCDATA)) {
+    const BYTE *data = (const BYTE *)LockResource(LoadResource(module,
+                                                               resource));
+    if (!data)
+      return nullptr;
+    image = make_shared<vector<BYTE>>(data,
+                                      data + SizeofResource(module, resource));
+  }
+  else
+    return nullptr;
+
+  variants[{module, variant}] = image;
+  return image;
+}
+
+
+// ------------------------------- Build IDs ------------------------------- //
+// Shims are stamped with the ID of their template (SHIM_TEMPLATE) so older
+// ones can be found and upgraded
+inline wstring ImageId(const vector<BYTE> &image) {
+  ULONGLONG hash = 0xCBF29CE484222325ULL;
+  for (BYTE b : image) {
+    hash ^= b;
+    hash *= 0x100000001B3ULL;
+  }
+
+  wchar_t id[17];
+  swprintf(id, 17, L"%016llx", hash);
+  return id;
+}
+
+// ID of template VARIANT of the executable, empty if there is none
+inline wstring TemplateId(const string &variant) {
+  auto image = TemplateImage(nullptr, variant);
+  return image ? ImageId(*image) : L"";
+}
+
+// ------------------------------------------------------------------------- //
+#endif  // TEMPLATE_STORE_H
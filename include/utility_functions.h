@@ -30,11 +30,39 @@
  *  UpperCase
  *      upper cases a string
  *  
- *  NarrowString
- *      converts a wstring -> string
+ *  NarrowString / WideString
+ *      converts a wstring -> string (UTF-8) and back
+ *
+ *  ReadFileData / WriteFileData
+ *      reads or (re)writes a whole file
  *  
  *  GetExecPath
  *      gets the path of the executable
+ *
+ *  GetEnvironment
+ *      gets an environment variable, empty if it is not set
+ *
+ *  ToNumber
+ *      parses a non-negative whole number (decimal or 0x hex), failing on
+ *      anything else (unlike _wtoi which quietly returns 0)
+ *
+ *  PriorityClass
+ *      maps IDLE, BELOW_NORMAL, NORMAL, ABOVE_NORMAL or HIGH to its process
+ *      priority class, 0 if unknown
+ *
+ *  PowerThrottling / MemoryPriority / IoPriority
+ *      map ON or OFF, a memory priority (VERY_LOW, LOW, MEDIUM, BELOW_NORMAL,
+ *      NORMAL) or an I/O priority (VERY_LOW, LOW, NORMAL) to the value passed
+ *      to the process, -1 if unknown
+ *
+ *  FormatDuration
+ *      formats milliseconds as seconds, e.g. "12.345 seconds"
+ *
+ *  JsonString
+ *      quotes and escapes a string for JSON output (UTF-8)
+ *
+ * The functions are inline as both SHIM_EXEC and the builder library it
+ * links include this.
  *  
  * ------------------------------------------------------------------------- 
  * This program is free software: you can redistribute it and/or modify
@@ -56,16 +84,22 @@
 
 // ------------------------------------------------------------------------- //
 #include <windows.h>
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cwchar>
+#include <cwctype>
 
 using namespace std;
 
 const string horizontal_line_bold(79, '=');
 const string horizontal_line(79, '-');
 
-wstring UnquoteString(const wstring& input) {
+inline wstring UnquoteString(const wstring& input) {
   wstring output;
 
   // Reserve space to avoid frequent re-allocations
@@ -85,7 +119,7 @@ wstring UnquoteString(const wstring& input) {
 }
 
 
-bool TrimQuotes(wstring& s) {
+inline bool TrimQuotes(wstring& s) {
   if(s.front() == '"' && s.back() == '"') {
     s.erase(s.begin());
     s.erase(s.end()-1);
@@ -95,14 +129,14 @@ bool TrimQuotes(wstring& s) {
 }
 
 
-bool UpperCase(wstring& s) {
+inline bool UpperCase(wstring& s) {
   transform(s.begin(), s.end(), s.begin(), ::toupper);
   return true;
 }
 
 
 // Convert Wide --> Narrow
-string NarrowString(const wstring& wstr) {
+inline string NarrowString(const wstring& wstr) {
   if (wstr.empty())
     return string();
   
@@ -119,11 +153,167 @@ string NarrowString(const wstring& wstr) {
 }
 
 
-filesystem::path GetExecPath() {
-  CHAR cExePath[MAX_PATH];  
-  GetModuleFileName(NULL, cExePath, MAX_PATH);
-  return filesystem::path(cExePath);
-}  
+// Convert Narrow (UTF-8) --> Wide
+inline wstring WideString(const string& str) {
+  if (str.empty())
+    return wstring();
+
+  int sz = MultiByteToWideChar(
+      CP_UTF8, 0, &str[0], (int)str.size(), 0, 0);
+
+  wstring res(sz, 0);
+  MultiByteToWideChar(
+      CP_UTF8, 0, &str[0], (int)str.size(), &res[0], sz);
+
+  return res;
+}
+
+
+inline bool ReadFileData(const filesystem::path& path, vector<BYTE>& data) {
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN,
+                            NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size = {};
+  bool read = GetFileSizeEx(file, &size) && size.QuadPart <= MAXDWORD;
+  if (read) {
+    data.resize((size_t)size.QuadPart);
+    DWORD bytes = 0;
+    read = data.empty() ||
+      (ReadFile(file, data.data(), (DWORD)data.size(), &bytes, NULL) &&
+       bytes == data.size());
+  }
+  CloseHandle(file);
+  return read;
+}
+
+
+inline bool WriteFileData(const filesystem::path& path,
+                          const vector<BYTE>& data) {
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, NULL,
+                            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  DWORD bytes = 0;
+  bool written = WriteFile(file, data.data(), (DWORD)data.size(), &bytes,
+                           NULL) && bytes == data.size();
+  CloseHandle(file);
+  return written;
+}
+
+
+// Wide and grown until it fits, so a shim under a long path or with
+// characters outside the ANSI code page finds itself (and its sidecar)
+inline filesystem::path GetExecPath() {
+  wstring path(MAX_PATH, L'\0');
+  while (true) {
+    DWORD length = GetModuleFileNameW(NULL, path.data(), (DWORD)path.size());
+    if (length == 0)
+      return filesystem::path();
+    if (length < path.size()) {
+      path.resize(length);
+      return filesystem::path(path);
+    }
+    path.resize(path.size() * 2);
+  }
+}
+
+
+inline wstring GetEnvironment(LPCWSTR name) {
+  wstring value(MAX_PATH, L'\0');
+  DWORD length = GetEnvironmentVariableW(name, value.data(), MAX_PATH);
+  if (length >= MAX_PATH) {
+    value.resize(length);
+    length = GetEnvironmentVariableW(name, value.data(), length);
+  }
+  value.resize(length < value.size() ? length : 0);
+  return value;
+}
+
+
+inline bool ToNumber(const wstring& s, ULONGLONG& value) {
+  if (s.empty() || !iswdigit(s.front()))
+    return false;
+
+  bool hex = s.size() > 2 && s[0] == L'0' && (s[1] == L'x' || s[1] == L'X');
+  if (hex && !iswxdigit(s[2]))
+    return false;
+
+  wchar_t* end = nullptr;
+  errno = 0;
+  value = wcstoull(s.c_str() + (hex ? 2 : 0), &end, hex ? 16 : 10);
+  return errno == 0 && *end == L'\0';
+}
+
+
+inline DWORD PriorityClass(wstring name) {
+  UpperCase(name);
+  if (name == L"IDLE")          return IDLE_PRIORITY_CLASS;
+  if (name == L"BELOW_NORMAL")  return BELOW_NORMAL_PRIORITY_CLASS;
+  if (name == L"NORMAL")        return NORMAL_PRIORITY_CLASS;
+  if (name == L"ABOVE_NORMAL")  return ABOVE_NORMAL_PRIORITY_CLASS;
+  if (name == L"HIGH")          return HIGH_PRIORITY_CLASS;
+  return 0;
+}
+
+
+inline int PowerThrottling(wstring name) {
+  UpperCase(name);
+  if (name == L"ON")            return 1;
+  if (name == L"OFF")           return 0;
+  return -1;
+}
+
+
+inline int MemoryPriority(wstring name) {
+  UpperCase(name);
+  if (name == L"VERY_LOW")      return MEMORY_PRIORITY_VERY_LOW;
+  if (name == L"LOW")           return MEMORY_PRIORITY_LOW;
+  if (name == L"MEDIUM")        return MEMORY_PRIORITY_MEDIUM;
+  if (name == L"BELOW_NORMAL")  return MEMORY_PRIORITY_BELOW_NORMAL;
+  if (name == L"NORMAL")        return MEMORY_PRIORITY_NORMAL;
+  return -1;
+}
+
+
+// Values of the native IO_PRIORITY_HINT (High needs a privilege)
+inline int IoPriority(wstring name) {
+  UpperCase(name);
+  if (name == L"VERY_LOW")      return 0;
+  if (name == L"LOW")           return 1;
+  if (name == L"NORMAL")        return 2;
+  return -1;
+}
+
+
+inline string FormatDuration(ULONGLONG milliseconds) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%llu.%03llu seconds",
+           milliseconds / 1000, milliseconds % 1000);
+  return buffer;
+}
+
+
+inline string JsonString(const wstring& value) {
+  string output = "\"";
+  for (char c : NarrowString(value)) {
+    if (c == '"' || c == '\\') {
+      output += '\\';
+      output += c;
+    }
+    else if ((unsigned char)c < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      output += escaped;
+    }
+    else
+      output += c;
+  }
+  return output + "\"";
+}
 
 
 // ------------------------------------------------------------------------- //
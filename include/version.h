@@ -15,6 +15,11 @@
 #define VER_DESC                "Creates shortcut-like 'shims' for an executable"
 
 
+// ----------------------------- Shim Builder ------------------------------ //
+#define VER_BUILDER_FILENAME    "SHIM_BUILDER"
+#define VER_BUILDER_DESC        "Builds shims in memory for other programs"
+
+
 // --------------------------------- Shim ---------------------------------- // 
 #define VER_SHIM_FILENAME       "SHIM"
 #define VER_SHIM_DESC           "An executable 'shim' created by " VER_FILENAME ".EXE"
@@ -2,32 +2,67 @@
 #include <log.h>
 #include <resource_functions.h>
 #include <get_argument.h>
+#include <shim_arguments.h>
 #include <utility_functions.h>
-
-#pragma comment(lib, "SHELL32.LIB")
+#include <tee.h>
+#include <journal.h>
+#include <script_functions.h>
+#include <sidecar.h>
 
 
 #ifndef ERROR_ELEVATION_REQUIRED
 #define ERROR_ELEVATION_REQUIRED 740
 #endif
 
-#define BUFSIZE 4096
-#define SHIM_ARG_PREFIX L"--shim"
+// Exit code when the target is terminated by --shim-Timeout (same as GNU
+// timeout so CI logs read the same)
+#define SHIM_EXIT_TIMEOUT 124
+// How long to wait for a terminated target to go, so a target that cannot
+// be terminated never keeps the shim waiting forever
+#define SHIM_TERMINATE_WAIT 10000       // ms
+
+// Settings of the <shim>.shim sidecar, read on first use and kept. Most shims
+// have none, which costs a single attribute query.
+const map<string, wstring> &ShimSidecar() {
+  static const map<string, wstring> settings = [] {
+    map<string, wstring> read;
+    ReadSidecar(SidecarPath(GetExecPath()), read);
+    return read;
+  }();
+  return settings;
+}
+
+// Setting from the sidecar, else the embedded one
+bool GetShimData(LPCSTR resource, wstring &value) {
+  const map<string, wstring> &sidecar = ShimSidecar();
+  auto found = sidecar.find(resource);
+  if (found == sidecar.end())
+    return GetResourceData(resource, value);
+  value = found->second;
+  return true;
+}
 
-bool GetShimArg(vector<wstring> &args, wstring pattern) {
-  wstring argFormat = SHIM_ARG_PREFIX;
-  argFormat += L"[a-z]*-";
-  argFormat += pattern;
-  argFormat += L"[a-z]*";
-  return GetArgument(args, argFormat);
+// Setting of the shim, replaced by its --shim-* override when one was given
+wstring GetShimSetting(LPCSTR resource, const wstring &override) {
+  wstring value = L"";
+  GetShimData(resource, value);
+  return override.empty() ? value : override;
 }
 
 
 // --------------------------- Process Creation ---------------------------- // 
+// Set when the target runs in its own process group (timeout grace period)
+DWORD childProcessGroup = 0;
+
 BOOL WINAPI CtrlHandler(DWORD ctrlType) {
   switch (ctrlType) {
-    // Ignore all events, and let the child process handle them.
+    // A new process group ignores Ctrl-C, so hand it over as Ctrl-Break
   case CTRL_C_EVENT:
+    if (childProcessGroup)
+      GenerateConsoleCtrlEvent(CTRL_BREAK_EVENT, childProcessGroup);
+    return TRUE;
+
+    // Ignore all events, and let the child process handle them.
   case CTRL_CLOSE_EVENT:
   case CTRL_LOGOFF_EVENT:
   case CTRL_BREAK_EVENT:
@@ -52,17 +87,96 @@ namespace std {
   typedef unique_ptr<HANDLE, HandleDeleter> unique_handle;
 }
 
-tuple<unique_handle, unique_handle> MakeProcess(
+// ShellExecuteExW is only needed on the rare ERROR_ELEVATION_REQUIRED path, so
+// SHELL32.DLL (and its sizable dependency graph) is bound at runtime rather
+// than imported. This keeps the shim's import table down to KERNEL32 and the
+// CRT on every other launch; see tools/check_imports.ps1.
+BOOL ShellExecuteElevated(SHELLEXECUTEINFOW *sei) {
+  HMODULE shell32 =
+    LoadLibraryExW(L"shell32.dll", nullptr, LOAD_LIBRARY_SEARCH_SYSTEM32);
+  if (!shell32)
+    return FALSE;
+
+  auto shellExecuteExW =
+    (decltype(&ShellExecuteExW))GetProcAddress(shell32, "ShellExecuteExW");
+  if (!shellExecuteExW)
+    return FALSE;
+
+  return shellExecuteExW(sei);
+}
+
+// Power throttling (EcoQoS), memory and I/O priority for the target. Set from
+// the QOS_* resources or --shim-* overrides; -1 leaves the default alone.
+struct ProcessQos {
+  int powerThrottling = -1;
+  int memoryPriority  = -1;
+  int ioPriority      = -1;
+
+  bool Any() const {
+    return powerThrottling >= 0 || memoryPriority >= 0 || ioPriority >= 0;
+  }
+};
+
+// There is no Win32 API for a process' I/O priority, so the native one is
+// looked up in NTDLL.DLL (always loaded, so this adds no import)
+typedef LONG (NTAPI *NtSetInformationProcessFunc)(HANDLE, ULONG, PVOID, ULONG);
+#define PROCESS_IO_PRIORITY 33
+
+void ApplyProcessQos(HANDLE process, const ProcessQos &qos) {
+  if (qos.powerThrottling >= 0) {
+    PROCESS_POWER_THROTTLING_STATE state = {};
+    state.Version     = PROCESS_POWER_THROTTLING_CURRENT_VERSION;
+    state.ControlMask = PROCESS_POWER_THROTTLING_EXECUTION_SPEED;
+    state.StateMask   =
+      qos.powerThrottling ? PROCESS_POWER_THROTTLING_EXECUTION_SPEED : 0;
+
+    if (!SetProcessInformation(process, ProcessPowerThrottling,
+                               &state, sizeof(state)))
+      LOG(2) << "Could not set power throttling";
+  }
+
+  if (qos.memoryPriority >= 0) {
+    MEMORY_PRIORITY_INFORMATION info = {};
+    info.MemoryPriority = (ULONG)qos.memoryPriority;
+
+    if (!SetProcessInformation(process, ProcessMemoryPriority,
+                               &info, sizeof(info)))
+      LOG(2) << "Could not set memory priority";
+  }
+
+  if (qos.ioPriority >= 0) {
+    auto ntSetInformationProcess = (NtSetInformationProcessFunc)
+      GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtSetInformationProcess");
+    ULONG ioPriority = (ULONG)qos.ioPriority;
+
+    if (!ntSetInformationProcess ||
+        ntSetInformationProcess(process, PROCESS_IO_PRIORITY,
+                                &ioPriority, sizeof(ioPriority)) < 0)
+      LOG(2) << "Could not set I/O priority";
+  }
+}
+
+// Starts the target, with its process and thread (nullptr when elevated) and
+// whether it joined JOB; an elevated target cannot be added by a shim that
+// is not elevated itself
+tuple<unique_handle, unique_handle, bool> MakeProcess(
     const wstring &path,
     const wstring &args,
-    const wstring &workingDirectory) {
+    const wstring &workingDirectory,
+    HANDLE job,
+    DWORD creationFlags,
+    const ProcessQos &qos,
+    const Tee *tee) {
   STARTUPINFOW        startInfo     = {};
   PROCESS_INFORMATION processInfo   = {};
   unique_handle       threadHandle;
   unique_handle       processHandle;
+  bool                inJob         = false;
 
-  // Build the Command Line
-  wstring cmd = path;
+  // Build the Command Line, quoting the program so a path with spaces is
+  // never split at the first one
+  wstring cmd = path.find(L' ') == wstring::npos ?
+    path : L"\"" + path + L"\"";
   if(!args.empty())
     cmd += L" " + args;
   
@@ -71,23 +185,45 @@ tuple<unique_handle, unique_handle> MakeProcess(
   if (!workingDirectory.empty()) {
       workingDirectoryCSTR = workingDirectory.c_str();
 
-      if (!PathFileExistsW(workingDirectoryCSTR))
+      if (GetFileAttributesW(workingDirectoryCSTR) == INVALID_FILE_ATTRIBUTES)
         LOG(2) <<
           "Working directory does not exist, process may fail to start";
   }
   
+  // Hand the target the tee pipes instead of our own output handles
+  if (tee) {
+    startInfo.cb          = sizeof(startInfo);
+    startInfo.dwFlags     = STARTF_USESTDHANDLES;
+    startInfo.hStdInput   = GetStdHandle(STD_INPUT_HANDLE);
+    startInfo.hStdOutput  = tee->Output();
+    startInfo.hStdError   = tee->Error();
+  }
+
   // Create the Process
   if (CreateProcessW(
           nullptr,                 // No module name (use command line)       
           cmd.data(),              // Command Line
           nullptr, nullptr, TRUE,  // Inheritance (Process, Thread, Handle)
-          CREATE_SUSPENDED,        // Suspend threads on creation
+          CREATE_SUSPENDED |       // Suspend threads on creation
+          creationFlags,
           nullptr,                 // Use parent's environment block          
           workingDirectoryCSTR,    // Starting directory         
           &startInfo, &processInfo)) {
     // Set the handles
     threadHandle.reset(processInfo.hThread);
     processHandle.reset(processInfo.hProcess);
+
+    // Join the job before any code runs so every grandchild is caught too
+    inJob = job && AssignProcessToJobObject(job, processHandle.get());
+    if (job && !inJob)
+      LOG(2) << "Could not add the target to the job: error "
+             << GetLastError();
+
+    if (creationFlags & CREATE_NEW_PROCESS_GROUP)
+      childProcessGroup = processInfo.dwProcessId;
+
+    // Still suspended, so these are in place before it runs any code
+    ApplyProcessQos(processHandle.get(), qos);
     
     // Start the thread
     ResumeThread(threadHandle.get());
@@ -101,6 +237,9 @@ tuple<unique_handle, unique_handle> MakeProcess(
 
     SHELLEXECUTEINFOW sei = {};
 
+    if (tee)
+      LOG(2) << "Elevated target runs in its own window, nothing to tee";
+
     sei.cbSize = sizeof(SHELLEXECUTEINFOW);
     sei.fMask = SEE_MASK_NOCLOSEPROCESS;
     sei.lpFile = path.c_str();
@@ -108,27 +247,339 @@ tuple<unique_handle, unique_handle> MakeProcess(
     sei.nShow = SW_SHOW;
     sei.lpDirectory = workingDirectoryCSTR;
 
-    if (!ShellExecuteExW(&sei)) {
+    if (!ShellExecuteElevated(&sei)) {
       LOG(1) << "Unable to create elevated process: error ";
       LOG(-1) << GetLastError();
-      return {move(processHandle), move(threadHandle)};
+      return {move(processHandle), move(threadHandle), false};
     }
 
     processHandle.reset(sei.hProcess);
+    inJob = job && AssignProcessToJobObject(job, processHandle.get());
+    ApplyProcessQos(processHandle.get(), qos);
   }
   else {
     LOG(1) << "Could not create process with command: ";
     LOG(-1) << "'" << cmd << "'";
-    return {move(processHandle), move(threadHandle)};
+    return {move(processHandle), move(threadHandle), false};
   }
 
   // Ignore Ctrl-C and other signals
   if (!SetConsoleCtrlHandler(CtrlHandler, TRUE)) 
     LOG(2) << "Could not set control handler; Ctrl-C behavior may be invalid";
 
-  return {move(processHandle), move(threadHandle)};
+  return {move(processHandle), move(threadHandle), inJob};
+}
+
+
+
+// Waits for the target, relaying its output meanwhile when teeing
+DWORD WaitForTarget(HANDLE process, DWORD timeout, Tee *tee) {
+  if (tee)
+    return tee->Relay(process, timeout);
+  return WaitForSingleObject(process, timeout);
+}
+
+
+
+// ---------------------------- Response Files ----------------------------- //
+// Characters CreateProcess takes in a command line, its NUL included
+#define COMMAND_LINE_LIMIT 32767
+
+// Writes ARGS to a new file in %TEMP% with a single write and returns its
+// path, empty on failure. Plain ASCII is written as is, anything else as
+// UTF-16 with a BOM, which is what the MSVC tools need (and LLVM reads too).
+wstring WriteResponseFile(const wstring &args) {
+  wchar_t directory[MAX_PATH + 1];
+  wchar_t path[MAX_PATH];
+  DWORD length = GetTempPathW(MAX_PATH + 1, directory);
+  if (!length || length > MAX_PATH ||
+      !GetTempFileNameW(directory, L"shm", 0, path))
+    return L"";
+
+  string data;
+  bool ascii = all_of(args.begin(), args.end(),
+                      [](wchar_t c) { return c < 0x80; });
+  if (ascii)
+    for (wchar_t c : args)
+      data += (char)c;
+  else {
+    data = "\xFF\xFE";
+    data.append((const char *)args.data(), args.size() * sizeof(wchar_t));
+  }
+
+  HANDLE file = CreateFileW(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_TEMPORARY, nullptr);
+  DWORD written = 0;
+  bool ok = file != INVALID_HANDLE_VALUE &&
+            WriteFile(file, data.data(), (DWORD)data.size(), &written,
+                      nullptr) &&
+            written == data.size();
+  if (file != INVALID_HANDLE_VALUE)
+    CloseHandle(file);
+  if (!ok) {
+    DeleteFileW(path);
+    return L"";
+  }
+  return path;
+}
+
+
+
+// ------------------------------- Footprint ------------------------------- //
+// Frees what VALUES hold; clear() would keep the memory
+template <class... T>
+void Release(T &...values) {
+  ((values = T()), ...);
+}
+
+// A waiting shim lives as long as its target, hundreds of them at once on a
+// busy machine. Free heap pages go back to the system and the working set is
+// emptied, so all that stays resident is what the wait touches again.
+void TrimFootprint() {
+  HeapCompact(GetProcessHeap(), 0);
+  SetProcessWorkingSetSize(GetCurrentProcess(), (SIZE_T)-1, (SIZE_T)-1);
+}
+
+
+
+// ------------------------------ Job Object ------------------------------- //
+// Resource limits embedded by the generator as LIMIT_* resources. They are
+// applied to the job holding the target and everything it starts.
+struct JobLimits {
+  ULONGLONG processMemory   = 0;        // MB, per process
+  ULONGLONG jobMemory       = 0;        // MB, whole tree
+  ULONGLONG processes       = 0;        // active processes
+  ULONGLONG cpuRate         = 0;        // percent of all processors
+  DWORD     priorityClass   = 0;
+  wstring   priorityName    = L"";
+  ULONGLONG affinity        = 0;
+
+  bool Any() const {
+    return processMemory || jobMemory || processes || cpuRate ||
+      priorityClass || affinity;
+  }
+};
+
+// Sizes and masks the job takes are SIZE_T and ULONG_PTR, so an x86 shim
+// tops out at 4095 MB and 32 processors; anything larger is rejected rather
+// than wrapped around
+bool GetJobLimits(JobLimits &limits) {
+  struct { LPCSTR name; ULONGLONG *value; ULONGLONG maximum; } numbers[] = {
+    {"LIMIT_PROCESS_MEMORY",  &limits.processMemory,  (SIZE_T)-1 >> 20},
+    {"LIMIT_JOB_MEMORY",      &limits.jobMemory,      (SIZE_T)-1 >> 20},
+    {"LIMIT_PROCESSES",       &limits.processes,      MAXDWORD},
+    {"LIMIT_CPU_RATE",        &limits.cpuRate,        100},
+    {"LIMIT_AFFINITY",        &limits.affinity,       (ULONG_PTR)-1},
+  };
+
+  wstring value;
+  for (auto &number : numbers) {
+    if (GetShimData(number.name, value) &&
+        (!ToNumber(value, *number.value) ||
+         *number.value > number.maximum)) {
+      LOG(1) << "Invalid " << number.name << " setting: '" << value << "'";
+      return false;
+    }
+  }
+
+  if (GetShimData("LIMIT_PRIORITY", limits.priorityName) &&
+      !(limits.priorityClass = PriorityClass(limits.priorityName))) {
+    LOG(1) << "Invalid LIMIT_PRIORITY setting: '"
+           << limits.priorityName << "'";
+    return false;
+  }
+
+  return true;
+}
+
+// A job object allows groups of processes to be managed as a unit. Operations
+// performed on a job object affect all processes associated with the job
+// object. KILL_ON_CLOSE makes sure they terminate when the shim terminates as
+// well; without it (i.e. not waiting) the job, and its limits, live on until
+// the last process in it exits. Unless WHOLE_TREE is set, grandchildren are
+// allowed to silently break away from the job. These flags are set on their
+// own first, so a limit the system refuses cannot take them along; that
+// limit is still an error, and no job is returned.
+HANDLE CreateShimJob(bool killOnClose, bool wholeTree, const JobLimits &limits) {
+  unique_handle job(CreateJobObject(nullptr, nullptr));
+  if (!job)
+    return nullptr;
+
+  JOBOBJECT_EXTENDED_LIMIT_INFORMATION jobInfo = {};
+  DWORD &flags = jobInfo.BasicLimitInformation.LimitFlags;
+
+  if (killOnClose)
+    flags |= JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+  if (!wholeTree)
+    flags |= JOB_OBJECT_LIMIT_SILENT_BREAKAWAY_OK;
+
+  if (!SetInformationJobObject(
+        job.get(),
+        JobObjectExtendedLimitInformation,
+        &jobInfo,
+        sizeof(jobInfo))) {
+    LOG(1) << "Could not set up the job: error " << GetLastError();
+    return nullptr;
+  }
+
+  if (limits.processMemory) {
+    flags |= JOB_OBJECT_LIMIT_PROCESS_MEMORY;
+    jobInfo.ProcessMemoryLimit = (SIZE_T)(limits.processMemory << 20);
+  }
+  if (limits.jobMemory) {
+    flags |= JOB_OBJECT_LIMIT_JOB_MEMORY;
+    jobInfo.JobMemoryLimit = (SIZE_T)(limits.jobMemory << 20);
+  }
+  if (limits.processes) {
+    flags |= JOB_OBJECT_LIMIT_ACTIVE_PROCESS;
+    jobInfo.BasicLimitInformation.ActiveProcessLimit = (DWORD)limits.processes;
+  }
+  if (limits.priorityClass) {
+    flags |= JOB_OBJECT_LIMIT_PRIORITY_CLASS;
+    jobInfo.BasicLimitInformation.PriorityClass = limits.priorityClass;
+  }
+  if (limits.affinity) {
+    flags |= JOB_OBJECT_LIMIT_AFFINITY;
+    jobInfo.BasicLimitInformation.Affinity = (ULONG_PTR)limits.affinity;
+  }
+
+  if (limits.Any() &&
+      !SetInformationJobObject(
+        job.get(),
+        JobObjectExtendedLimitInformation,
+        &jobInfo,
+        sizeof(jobInfo))) {
+    LOG(1) << "Could not set job limits: error " << GetLastError();
+    return nullptr;
+  }
+
+  // The CPU rate is a hard cap in 1/100ths of a percent of all processors
+  if (limits.cpuRate) {
+    JOBOBJECT_CPU_RATE_CONTROL_INFORMATION rateInfo = {};
+    rateInfo.ControlFlags =
+      JOB_OBJECT_CPU_RATE_CONTROL_ENABLE |
+      JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP;
+    rateInfo.CpuRate = (DWORD)min<ULONGLONG>(limits.cpuRate, 100) * 100;
+
+    if (!SetInformationJobObject(
+          job.get(),
+          JobObjectCpuRateControlInformation,
+          &rateInfo,
+          sizeof(rateInfo))) {
+      LOG(1) << "Could not set job CPU rate: error " << GetLastError();
+      return nullptr;
+    }
+  }
+
+  return job.release();
 }
 
+// Resource usage of the whole tree, read back from the job once the target
+// has exited. Times are in milliseconds, memory in bytes.
+struct JobStats {
+  ULONGLONG wallTime          = 0;
+  ULONGLONG userTime          = 0;
+  ULONGLONG kernelTime        = 0;
+  ULONGLONG processes         = 0;
+  ULONGLONG peakProcessMemory = 0;
+  ULONGLONG peakJobMemory     = 0;
+  ULONGLONG readBytes         = 0;
+  ULONGLONG readOperations    = 0;
+  ULONGLONG writeBytes        = 0;
+  ULONGLONG writeOperations   = 0;
+};
+
+bool GetJobStats(HANDLE job, JobStats &stats) {
+  JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION accounting = {};
+  JOBOBJECT_EXTENDED_LIMIT_INFORMATION          limits     = {};
+
+  if (!QueryInformationJobObject(job, JobObjectBasicAndIoAccountingInformation,
+                                 &accounting, sizeof(accounting), nullptr) ||
+      !QueryInformationJobObject(job, JobObjectExtendedLimitInformation,
+                                 &limits, sizeof(limits), nullptr))
+    return false;
+
+  // 100ns units
+  stats.userTime          =
+    accounting.BasicInfo.TotalUserTime.QuadPart / 10000;
+  stats.kernelTime        =
+    accounting.BasicInfo.TotalKernelTime.QuadPart / 10000;
+  stats.processes         = accounting.BasicInfo.TotalProcesses;
+  stats.peakProcessMemory = limits.PeakProcessMemoryUsed;
+  stats.peakJobMemory     = limits.PeakJobMemoryUsed;
+  stats.readBytes         = accounting.IoInfo.ReadTransferCount;
+  stats.readOperations    = accounting.IoInfo.ReadOperationCount;
+  stats.writeBytes        = accounting.IoInfo.WriteTransferCount;
+  stats.writeOperations   = accounting.IoInfo.WriteOperationCount;
+  return true;
+}
+
+/**@brief  Reports job statistics
+ *
+ * @param  TARGET:  STDERR, LOG or the path of a JSON file (overwritten)
+ * @param  APPPATH: the target, for the JSON report
+ */
+void ReportJobStats(const JobStats &stats, const wstring &target,
+                    const wstring &appPath, DWORD exitCode) {
+  wstring where = target;
+  UpperCase(where);
+
+  if (where == L"LOG") {
+    LOG(3) << "Job statistics:";
+    LOG() << "  Wall Time:    " << FormatDuration(stats.wallTime);
+    LOG() << "  User Time:    " << FormatDuration(stats.userTime);
+    LOG() << "  Kernel Time:  " << FormatDuration(stats.kernelTime);
+    LOG() << "  Processes:    " << stats.processes;
+    LOG() << "  Peak Process: " << (stats.peakProcessMemory >> 10) << " KB";
+    LOG() << "  Peak Job:     " << (stats.peakJobMemory >> 10) << " KB";
+    LOG() << "  Read:         " << stats.readBytes << " bytes in "
+          << stats.readOperations << " operations";
+    LOG() << "  Written:      " << stats.writeBytes << " bytes in "
+          << stats.writeOperations << " operations";
+    return;
+  }
+
+  char line[512];
+  if (where == L"STDERR") {
+    // One line, straight to the real stderr so it can be grepped from CI logs
+    int length = snprintf(
+      line, sizeof(line),
+      "shim stats: wall %s, user %llu ms, kernel %llu ms, %llu processes, "
+      "peak process %llu KB, peak job %llu KB, read %llu bytes, "
+      "written %llu bytes, exit %lu\n",
+      FormatDuration(stats.wallTime).c_str(), stats.userTime,
+      stats.kernelTime, stats.processes, stats.peakProcessMemory >> 10,
+      stats.peakJobMemory >> 10, stats.readBytes, stats.writeBytes,
+      exitCode);
+    DWORD written = 0;
+    if (length > 0)
+      WriteFile(GetStdHandle(STD_ERROR_HANDLE), line,
+                (DWORD)min<int>(length, sizeof(line) - 1), &written, nullptr);
+    return;
+  }
+
+  snprintf(line, sizeof(line),
+           ",\n  \"exit_code\": %lu"
+           ",\n  \"wall_ms\": %llu"
+           ",\n  \"user_ms\": %llu"
+           ",\n  \"kernel_ms\": %llu"
+           ",\n  \"processes\": %llu"
+           ",\n  \"peak_process_memory\": %llu"
+           ",\n  \"peak_job_memory\": %llu"
+           ",\n  \"read_bytes\": %llu"
+           ",\n  \"read_operations\": %llu"
+           ",\n  \"write_bytes\": %llu"
+           ",\n  \"write_operations\": %llu\n}\n",
+           exitCode, stats.wallTime, stats.userTime, stats.kernelTime,
+           stats.processes, stats.peakProcessMemory, stats.peakJobMemory,
+           stats.readBytes, stats.readOperations, stats.writeBytes,
+           stats.writeOperations);
+
+  ofstream json(filesystem::path(target), ios::out | ios::trunc);
+  json << "{\n  \"target\": " << JsonString(appPath) << line;
+  if (!json)
+    LOG(2) << "Could not write job statistics to '" << target << "'";
+}
 
 
 // ----------------------------- Help Message ------------------------------ // 
@@ -140,6 +591,10 @@ void ShowHelp() {
 named the same located elsewhere). Execute with --shim-NoOp to identify its
 target.
 
+Its settings are embedded in it, unless a file named like it with the extension
+.shim sits next to it: its lines (path = ..., args = ..., timeout = ...) take
+precedence, so they can be changed without rewriting the shim.
+
 Execute SHIM_EXEC -h or visit https://github.com/rixtox/shim_executable for
 additional information.
 
@@ -160,8 +615,16 @@ All other argument are passed to the parent executable.
     --shim-Help     Shows this help menu and exits without running the target
 
     --shim-Log      Turns on diagnostic messaging in the console. If a windows
-                        application executed without a console, a file (<shim
-                        path>.SHIM.LOG) will be generated instead.
+                        application executed without a console, the messages
+                        are appended to a file (<shim path>.LOG, or
+                        <shim>-<hash of its directory>.LOG in
+                        %LOCALAPPDATA%\shim_executable or %TEMP% if that is
+                        not writable) in whole records tagged with time and
+                        PID, never mixed with other launches (a waiting shim
+                        writes one before the wait and one at exit). It is
+                        rotated at SHIM_LOG_SIZE bytes (1 MB, 0 for never)
+                        keeping SHIM_LOG_FILES old ones (3), both taken from
+                        the environment.
                         (alias --shimgen-log)
 
     --shim-Wait     Explicitly tell the shim to wait for target to exit. Useful
@@ -192,6 +655,51 @@ All other argument are passed to the parent executable.
                     Override working directory path. Used when type is PATH
                         (from embedded config or --shim-WdType PATH).
 
+    --shim-Timeout SECONDS
+                    Terminate the target, and every process it started, if it
+                        is still running after SECONDS (0 waits forever). The
+                        shim then exits with code 124. Overrides the timeout
+                        embedded with --timeout. Only applies when waiting.
+
+    --shim-TimeoutGrace SECONDS
+                    When the timeout expires, first send Ctrl-Break to the
+                        target and allow it SECONDS to exit before the tree is
+                        terminated. The target then runs in its own process
+                        group and Ctrl-C is passed on to it as Ctrl-Break.
+                        Overrides the grace embedded with --timeout-grace.
+
+    --shim-PowerThrottling ON|OFF
+                    Start the target with power throttling (EcoQoS) on, which
+                        suits background tools, or explicitly off (HighQoS)
+                        for interactive ones. Overrides --power-throttling.
+
+    --shim-MemoryPriority LEVEL
+                    Memory priority of the target: VERY_LOW, LOW, MEDIUM,
+                        BELOW_NORMAL or NORMAL. Overrides --memory-priority.
+
+    --shim-IoPriority LEVEL
+                    I/O priority of the target: VERY_LOW, LOW or NORMAL.
+                        Overrides --io-priority.
+
+    --shim-Tee FILE
+                    Copy everything the target writes to stdout and stderr into
+                        FILE while still showing it as usual. Implies waiting
+                        for the target. Overrides the file embedded with --tee.
+
+    --shim-Stats TARGET
+                    Report the CPU time, peak memory, I/O and process count of
+                        the target and everything it started once it exits.
+                        TARGET is STDERR (one line), LOG (the shim's log) or
+                        the path of a JSON file. Only applies when waiting.
+                        Overrides the target embedded with --job-stats.
+
+    --shim-ResponseFile CHARS
+                    Pass the arguments in a response file (@FILE) when the
+                        command line would be longer than CHARS characters
+                        (at most 32767), for targets that read them, e.g.
+                        compilers and linkers. The file is deleted once the
+                        target exits. Overrides --response-file.
+
     --shim-NoOp     Executes the shim without calling the target application.
                         Logging is implicitly turned on.
                         (alias --shimgen-noop))V0G0N";
@@ -203,6 +711,14 @@ All other argument are passed to the parent executable.
 // ----------------------------- Main Function ----------------------------- // 
 int ShimMain() {
   DWORD exitCode            = 1;
+
+  // Rotation of the log file, when there is no console to log to
+  ULONGLONG logSize         = 0;
+  ULONGLONG logFiles        = 0;
+  if (ToNumber(GetEnvironment(L"SHIM_LOG_SIZE"), logSize))
+    LOGCFG.rotate_size = logSize;
+  if (ToNumber(GetEnvironment(L"SHIM_LOG_FILES"), logFiles))
+    LOGCFG.rotate_count = (int)min<ULONGLONG>(logFiles, 100);
   
   // --------------------- Get Command Line Arguments ---------------------- //
   filesystem::path thisExecPath  = GetExecPath();
@@ -211,26 +727,31 @@ int ShimMain() {
   wstring shimDir           = thisExecPath.parent_path().c_str();
   wstring currDir           = filesystem::current_path().c_str();
 
-  wstring calling_cmd       = GetCommandLineW();
-  vector<wstring> arg_list  = ParseArguments(calling_cmd);
-  GetArgument(arg_list, 0, calling_cmd);
-      
-  bool shimArgLog           = GetShimArg(arg_list, L"l");    
-  bool shimArgWait          = GetShimArg(arg_list, L"w");
-  bool shimArgExit          = GetShimArg(arg_list, L"e");
-  bool isWindowsApp         = GetShimArg(arg_list, L"g");
-  bool shimArgNoop          = GetShimArg(arg_list, L"n");
-
-  wstring wdTypeOverride    = L"";
-  wstring wdPathOverride    = L"";
-  GetArgument(arg_list, L"--shim-wdtype", wdTypeOverride);
-  GetArgument(arg_list, L"--shim-wdpath", wdPathOverride);
+  // Everything after the shim's own name, less the --shim flags. If there
+  // still exists an argument starting with "--shim" just run help
+  ShimArguments shimArgs;
+  ReadShimArguments(GetCommandLineW(), shimArgs);
+  if (shimArgs.help)
+    ShowHelp();
 
-  // If there still exists an argument starting with "--shim" and just run help 
-  if(GetArgument(arg_list, L"--shim.*")) ShowHelp();
+  const wstring &wdTypeOverride   = shimArgs.wdType;
+  const wstring &wdPathOverride   = shimArgs.wdPath;
+  const wstring &timeoutOverride  = shimArgs.timeout;
+  const wstring &graceOverride    = shimArgs.timeoutGrace;
+  const wstring &powerOverride    = shimArgs.powerThrottling;
+  const wstring &memoryOverride   = shimArgs.memoryPriority;
+  const wstring &ioOverride       = shimArgs.ioPriority;
+  const wstring &teeOverride      = shimArgs.tee;
+  const wstring &statsOverride    = shimArgs.stats;
+  const wstring &responseOverride = shimArgs.responseFile;
+  bool shimArgLog           = shimArgs.log;
+  bool shimArgWait          = shimArgs.wait;
+  bool shimArgExit          = shimArgs.exit;
+  bool isWindowsApp         = shimArgs.gui;
+  bool shimArgNoop          = shimArgs.noop;
 
   // Any arguments left, save to pass to parent executable
-  wstring calling_args      = CollapseArguments(arg_list);
+  const wstring &calling_args     = shimArgs.callingArgs;
       
   // Print useful info
   if (shimArgLog || shimArgNoop) {
@@ -247,6 +768,9 @@ int ShimMain() {
     LOG();
     LOG() << "Shim Path:      " << "'" << shimDir << "'";
     LOG() << "Current Path:   " << "'" << currDir << "'";
+    if (!ShimSidecar().empty())
+      LOG() << "Sidecar:        " << "'"
+            << SidecarPath(thisExecPath).wstring() << "'";
     LOG();
     
     LOG() << "Command Line Parameters:";
@@ -259,6 +783,22 @@ int ShimMain() {
       LOG() << "  WdType over:  " << (wdTypeOverride.empty() ? L"<none>" : wdTypeOverride);
       LOG() << "  WdPath over:  " << (wdPathOverride.empty() ? L"<none>" : wdPathOverride);
     }
+    if (!timeoutOverride.empty())
+      LOG() << "  Timeout:      " << timeoutOverride;
+    if (!graceOverride.empty())
+      LOG() << "  Grace:        " << graceOverride;
+    if (!powerOverride.empty())
+      LOG() << "  Power Throt:  " << powerOverride;
+    if (!memoryOverride.empty())
+      LOG() << "  Memory Prio:  " << memoryOverride;
+    if (!ioOverride.empty())
+      LOG() << "  I/O Prio:     " << ioOverride;
+    if (!teeOverride.empty())
+      LOG() << "  Tee:          " << teeOverride;
+    if (!statsOverride.empty())
+      LOG() << "  Stats:        " << statsOverride;
+    if (!responseOverride.empty())
+      LOG() << "  Response:     " << responseOverride;
 
     if(calling_args.empty()) {
       LOG() << "  App Args:     "
@@ -285,7 +825,7 @@ int ShimMain() {
   wstring appArgs   = L"";
   wstring shimType  = L"";
   
-  if (!GetResourceData("SHIM_PATH", appPath)) {
+  if (!GetShimData("SHIM_PATH", appPath)) {
     LOG(1)  << "Shim has no application path. ";
     LOG(-1) << "Shim is no longer valid and must be regenerated.";
     return exitCode;
@@ -304,13 +844,18 @@ int ShimMain() {
     exitCode = 0;
 
   appDir = filesystem::path(appPath).parent_path().c_str();
-  GetResourceData("SHIM_ARGS", appArgs);
+  GetShimData("SHIM_ARGS", appArgs);
   GetResourceData("SHIM_TYPE", shimType);
 
+  // Scripts run in the interpreter found when the shim was created
+  wstring interpreter = L"";
+  GetShimData("SHIM_INTERPRETER", interpreter);
+
   wstring wdType = L"";
   wstring wdPath = L"";
-  GetResourceData("WD_TYPE", wdType);
-  GetResourceData("WD_PATH", wdPath);
+  GetShimData("WD_TYPE", wdType);
+  GetShimData("WD_PATH", wdPath);
+  UpperCase(wdType);
 
   if (!wdTypeOverride.empty()) {
     wdType = wdTypeOverride;
@@ -319,22 +864,133 @@ int ShimMain() {
   if (!wdPathOverride.empty())
     wdPath = wdPathOverride;
 
+  wstring timeout = GetShimSetting("SHIM_TIMEOUT", timeoutOverride);
+  wstring grace   = GetShimSetting("SHIM_TIMEOUT_GRACE", graceOverride);
+
+  ULONGLONG timeoutSeconds  = 0;
+  ULONGLONG graceSeconds    = 0;
+  if (!timeout.empty() && !ToNumber(timeout, timeoutSeconds)) {
+    LOG(1) << "Timeout must be a whole number of seconds (got '"
+           << timeout << "')";
+    return 1;
+  }
+  if (!grace.empty() && !ToNumber(grace, graceSeconds)) {
+    LOG(1) << "Timeout grace must be a whole number of seconds (got '"
+           << grace << "')";
+    return 1;
+  }
+
+  JobLimits limits;
+  if (!GetJobLimits(limits))
+    return 1;
+
+  wstring power   = GetShimSetting("QOS_POWER_THROTTLING", powerOverride);
+  wstring memory  = GetShimSetting("QOS_MEMORY_PRIORITY", memoryOverride);
+  wstring io      = GetShimSetting("QOS_IO_PRIORITY", ioOverride);
+  UpperCase(power);
+  UpperCase(memory);
+  UpperCase(io);
+
+  ProcessQos qos;
+  if (!power.empty() && (qos.powerThrottling = PowerThrottling(power)) < 0) {
+    LOG(1) << "Power throttling must be ON or OFF (got '" << power << "')";
+    return 1;
+  }
+  if (!memory.empty() && (qos.memoryPriority = MemoryPriority(memory)) < 0) {
+    LOG(1) << "Memory priority must be VERY_LOW, LOW, MEDIUM, BELOW_NORMAL "
+           << "or NORMAL (got '" << memory << "')";
+    return 1;
+  }
+  if (!io.empty() && (qos.ioPriority = IoPriority(io)) < 0) {
+    LOG(1) << "I/O priority must be VERY_LOW, LOW or NORMAL (got '"
+           << io << "')";
+    return 1;
+  }
+
+  wstring response = GetShimSetting("SHIM_RESPONSE_FILE", responseOverride);
+  ULONGLONG responseLimit = 0;
+  if (!response.empty() &&
+      (!ToNumber(response, responseLimit) || responseLimit == 0 ||
+       responseLimit > COMMAND_LINE_LIMIT)) {
+    LOG(1) << "Response file limit must be a number of characters between "
+           << "1 and " << COMMAND_LINE_LIMIT << " (got '" << response << "')";
+    return 1;
+  }
+
+  wstring teePath = GetShimSetting("SHIM_TEE", teeOverride);
+  TrimQuotes(teePath);
+
   // Here forward we'll just use shimArgWait
   if (shimType == L"CONSOLE")
     shimArgWait = !shimArgExit;
 
+  // Someone has to relay the output, so tee implies waiting
+  if (!teePath.empty() && shimArgExit) {
+    LOG(1) << "SHIM-TEE cannot be used with SHIM-EXIT or SHIM-GUI";
+    return 1;
+  }
+  if (!teePath.empty())
+    shimArgWait = true;
+
+  wstring statsTarget = GetShimSetting("SHIM_STATS", statsOverride);
+  TrimQuotes(statsTarget);
+  if (!statsTarget.empty() && !shimArgWait) {
+    LOG(2) << "Job statistics need the shim to wait, ignoring SHIM-STATS";
+    statsTarget.clear();
+  }
+
+  // The environment wins over the embedded directory, so a whole fleet of
+  // shims can be pointed at one journal without regenerating them
+  wstring journalDir =
+    GetShimSetting("SHIM_JOURNAL", GetEnvironment(L"SHIM_JOURNAL"));
+  TrimQuotes(journalDir);
+
   // Print useful info
   if (shimArgLog) {
     LOG() << "Embedded Parameters:";
     LOG() << "  Shim Type:    " << shimType; 
     LOG() << "  App Name:     " << filesystem::path(appPath).stem();
     LOG() << "  App Path:     " << "'" << appDir << "'";
+    if (!interpreter.empty())
+      LOG() << "  Interpreter:  " << interpreter;
     if (!wdType.empty())
       LOG() << "  WD Type:      " << wdType << (wdType == L"PATH" && !wdPath.empty() ? L" (" + wdPath + L")" : L"");
     if(appArgs.empty()) 
       LOG() << "  App Args:     " << "<NONE>";
     else 
       LOG() << "  App Args:     " << "'" << appArgs << "'";
+    if (timeoutSeconds > 0) {
+      LOG() << "  Timeout:      " << timeoutSeconds << " seconds";
+      if (graceSeconds > 0)
+        LOG() << "  Grace:        " << graceSeconds << " seconds";
+    }
+    if (limits.processMemory)
+      LOG() << "  Process Mem:  " << limits.processMemory << " MB";
+    if (limits.jobMemory)
+      LOG() << "  Job Mem:      " << limits.jobMemory << " MB";
+    if (limits.processes)
+      LOG() << "  Processes:    " << limits.processes;
+    if (limits.cpuRate)
+      LOG() << "  CPU Rate:     " << limits.cpuRate << "%";
+    if (limits.priorityClass)
+      LOG() << "  Priority:     " << limits.priorityName;
+    if (limits.affinity)
+      LOG() << "  Affinity:     " << limits.affinity;
+    if (qos.powerThrottling >= 0)
+      LOG() << "  Power Throt:  " << power
+            << (qos.powerThrottling ? " (EcoQoS)" : " (HighQoS)");
+    if (qos.memoryPriority >= 0)
+      LOG() << "  Memory Prio:  " << memory;
+    if (qos.ioPriority >= 0)
+      LOG() << "  I/O Prio:     " << io;
+    if (!teePath.empty())
+      LOG() << "  Tee:          " << "'" << teePath << "'";
+    if (!statsTarget.empty())
+      LOG() << "  Stats:        " << statsTarget;
+    if (!journalDir.empty())
+      LOG() << "  Journal:      " << "'" << journalDir << "'";
+    if (responseLimit)
+      LOG() << "  Response:     " << "over " << responseLimit << " characters";
     LOG();
 
     if (shimArgWait) {
@@ -378,10 +1034,48 @@ int ShimMain() {
   
   
   // ----------------------------- Execute App ----------------------------- //
+  // A script is only an argument of its interpreter
+  wstring launchPath;
+  wstring launchArgs;
+  auto launchCommand = [&] {
+    launchPath = appPath;
+    launchArgs = appArgs;
+    if (!interpreter.empty())
+      InterpreterCommand(interpreter, appPath, appArgs, launchPath,
+                         launchArgs);
+  };
+  launchCommand();
+
+  // Arguments that would make the command line too long go into a response
+  // file instead (program, quotes, space and NUL counted). It is deleted
+  // when the shim is done with the target, however it gets there.
+  struct ResponseFile {
+    wstring path;
+    ~ResponseFile() { if (!path.empty()) DeleteFileW(path.c_str()); }
+  } responseFile;
+  if (responseLimit && !appArgs.empty() &&
+      launchPath.size() + launchArgs.size() + 4 > responseLimit) {
+    if (shimArgNoop)
+      LOG() << "Arguments would be passed in a response file";
+    else {
+      responseFile.path = WriteResponseFile(appArgs);
+      if (responseFile.path.empty()) {
+        LOG(1) << "Could not write response file: error " << GetLastError();
+        return 1;
+      }
+      if (shimArgLog)
+        LOG() << "Arguments passed in response file '"
+              << responseFile.path << "'";
+      appArgs = responseFile.path.find(L' ') == wstring::npos ?
+        L"@" + responseFile.path : L"\"@" + responseFile.path + L"\"";
+      launchCommand();
+    }
+  }
+
   if (shimArgLog) {
     LOG() << "Creating process for application";
-    LOG() << "  APP: " << "'" << appPath << "'";
-    LOG() << "  ARG: " << "'" << appArgs << "'";
+    LOG() << "  APP: " << "'" << launchPath << "'";
+    LOG() << "  ARG: " << "'" << launchArgs << "'";
     LOG() << "  DIR: " << "'" << working_dir << "'";
     LOG() << horizontal_line;
   }
@@ -392,37 +1086,138 @@ int ShimMain() {
     return exitCode;
   }
   
-  auto [processHandle, threadHandle] =
-    MakeProcess(move(appPath), move(appArgs), working_dir);
+  // Attach the target to a job so it terminates with the shim when waiting,
+  // and to apply any embedded limits. A timeout, limits or statistics have to
+  // cover the whole tree, otherwise grandchildren would silently break away.
+  unique_handle jobHandle;
+  if (shimArgWait || limits.Any())
+    jobHandle.reset(CreateShimJob(
+        shimArgWait,
+        timeoutSeconds > 0 || limits.Any() || !statsTarget.empty(),
+        limits));
+  if (limits.Any() && !jobHandle) {
+    LOG(1) << "Could not apply the resource limits, not starting the target";
+    return 1;
+  }
+
+  DWORD creationFlags = 0;
+  if (shimArgWait && timeoutSeconds > 0 && graceSeconds > 0)
+    creationFlags |= CREATE_NEW_PROCESS_GROUP;
+
+  unique_ptr<Tee> tee;
+  if (!teePath.empty()) {
+    tee = make_unique<Tee>();
+    if (!tee->Open(teePath)) {
+      LOG(1) << "Could not open tee file '" << teePath << "': error ";
+      LOG(-1) << GetLastError();
+      return 1;
+    }
+  }
+
+  auto [processHandle, threadHandle, inJob] =
+    MakeProcess(launchPath, move(launchArgs), working_dir,
+                jobHandle.get(), creationFlags, qos, tee.get());
+  if (tee)
+    tee->CloseChildEnds();
+
+  // Without waiting there is no telling when the target is done with it, so
+  // the response file is left to the temp directory's cleanup
+  if (processHandle && !shimArgWait)
+    responseFile.path.clear();
+  ULONGLONG startTick = GetTickCount64();
+  FILETIME launched;
+  GetSystemTimePreciseAsFileTime(&launched);
   
   exitCode = processHandle ? 0 : 1;
 
   // Wait for app to finish when
+  bool timedOut = false;
   if (processHandle && shimArgWait) {
-    // A job object allows groups of processes to be managed as a unit.
-    // Operations performed on a job object affect all processes associated with
-    // the job object. Specifically here we attach to child processes to make
-    // sure they terminate when the parent terminates as well.   
-    unique_handle jobHandle(CreateJobObject(nullptr, nullptr));
-    JOBOBJECT_EXTENDED_LIMIT_INFORMATION jobInfo = {};
-
-    jobInfo.BasicLimitInformation.LimitFlags = 
-      JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE |
-      JOB_OBJECT_LIMIT_SILENT_BREAKAWAY_OK;
-    
-    SetInformationJobObject(
-      jobHandle.get(),
-      JobObjectExtendedLimitInformation,
-      &jobInfo,
-      sizeof(jobInfo));
-    
-    AssignProcessToJobObject(jobHandle.get(), processHandle.get());
-    
+    DWORD timeoutMs = timeoutSeconds == 0 ? INFINITE :
+      (DWORD)min<ULONGLONG>(timeoutSeconds * 1000, INFINITE - 1);
+
+    // Nothing from startup is needed past this point
+    Release(shimArgs, shimExe, shimDir, currDir, appDir, shimType, wdType,
+            wdPath, working_dir, timeout, grace, power, memory, io, teePath,
+            interpreter, launchPath, appArgs, response);
+    // The startup goes out as its own record, readable while the target
+    // runs; the exit follows as a second one with the same PID
+    LogFlush();
+    TrimFootprint();
+
     // Wait till end of process
-    WaitForSingleObject(processHandle.get(), INFINITE);
+    if (WaitForTarget(processHandle.get(), timeoutMs, tee.get()) ==
+        WAIT_TIMEOUT) {
+      LOG(1) << "Target did not exit within " << timeoutSeconds
+             << " seconds, terminating it";
+
+      // Give it a chance to shut down cleanly first
+      if (graceSeconds > 0 && childProcessGroup &&
+          GenerateConsoleCtrlEvent(CTRL_BREAK_EVENT, childProcessGroup)) {
+        LOG(-1) << "Sent Ctrl-Break, allowing " << graceSeconds
+                << " seconds to exit";
+        WaitForTarget(
+          processHandle.get(),
+          (DWORD)min<ULONGLONG>(graceSeconds * 1000, INFINITE - 1),
+          tee.get());
+      }
+
+      // Whatever is left of the tree goes with it, or just the target when
+      // it is not in the job (no job, or elevated)
+      if (inJob)
+        TerminateJobObject(jobHandle.get(), SHIM_EXIT_TIMEOUT);
+      else
+        TerminateProcess(processHandle.get(), SHIM_EXIT_TIMEOUT);
+      if (WaitForTarget(processHandle.get(), SHIM_TERMINATE_WAIT,
+                        tee.get()) == WAIT_TIMEOUT)
+        LOG(1) << "Could not terminate the target, leaving it running";
+      exitCode = SHIM_EXIT_TIMEOUT;
+      timedOut = true;
+    }
+    else
+      // Get the exit code
+      GetExitCodeProcess(processHandle.get(), &exitCode);
+
+    ULONGLONG elapsed = GetTickCount64() - startTick;
+    if (shimArgLog || timedOut)
+      LOG(3) << "Target ran for " << FormatDuration(elapsed);
+
+    JobStats stats;
+    if (!statsTarget.empty()) {
+      if (jobHandle && GetJobStats(jobHandle.get(), stats)) {
+        stats.wallTime = elapsed;
+        ReportJobStats(stats, statsTarget, appPath, exitCode);
+      }
+      else
+        LOG(2) << "Could not query job statistics";
+    }
+  }
+
+  // Record the launch; only ever costs a few microseconds and never fails
+  if (!journalDir.empty()) {
+    FILETIME created, finished, unused;
+    GetProcessTimes(GetCurrentProcess(), &created, &unused, &unused, &unused);
+    GetSystemTimePreciseAsFileTime(&finished);
+    auto ticks = [](const FILETIME &time) {
+      return ((ULONGLONG)time.dwHighDateTime << 32) | time.dwLowDateTime;
+    };
+
+    JournalRecord record = {};
+    record.timestamp  = ticks(launched);
+    record.shimId     = JournalShimId(thisExecPath.wstring());
+    record.overhead   = (DWORD)min<ULONGLONG>(
+      (ticks(launched) - min(ticks(created), ticks(launched))) / 10, MAXDWORD);
+    record.exitCode   = exitCode;
+    record.processId  = GetCurrentProcessId();
+    record.flags      = (!processHandle ? JOURNAL_FAILED : 0) |
+                        (timedOut ? JOURNAL_TIMED_OUT : 0);
+    if (processHandle && shimArgWait) {
+      record.flags   |= JOURNAL_WAITED;
+      record.duration = (ticks(finished) - ticks(launched)) / 10;
+    }
+    wcsncpy(record.name, thisExecPath.filename().c_str(), JOURNAL_NAME - 1);
 
-    // Get the exit code
-    GetExitCodeProcess(processHandle.get(), &exitCode);
+    JournalAppend(journalDir, record);
   }
 
   if (shimArgLog) {
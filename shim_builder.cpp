@@ -0,0 +1,323 @@
+// ------------------------------------------------------------------------- //
+// Shim Builder                                                              //
+// ------------------------------------------------------------------------- //
+/**@file    SHIM_BUILDER.CPP
+ * @brief   Builds shims in memory, behind the C interface of SHIM_BUILDER.H
+ * @date    10/16/2026
+ *
+ * -------------------------------------------------------------------------
+ * The template is copied out of this module's template store (or taken from
+ * the configuration): the one built for the target's architecture (or the one
+ * asked for) if there is one, else the one built with this module. The
+ * target's icons and version info plus the settings are merged into its
+ * resource list, and the resource section is written anew.
+ * SHIM_EXEC.EXE links the same code statically; its own validation is only
+ * there for friendlier messages.
+ *
+ * -------------------------------------------------------------------------
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ * ------------------------------------------------------------------------- */
+
+#include <shim_builder.h>
+#include <pe_resources.h>
+#include <pe_machine.h>
+#include <template_store.h>
+#include <utility_functions.h>
+
+#include <new>
+
+// Field of CONFIG, or zero if the caller's struct is older than the field
+#define CONFIG_FIELD(config, field)                                         \
+  ((config).size >= offsetof(ShimBuildConfig, field) + sizeof((config).field) \
+   ? (config).field : 0)
+
+
+// ------------------------------ Settings --------------------------------- //
+wstring Setting(const wchar_t* value) {
+  return value ? value : L"";
+}
+
+bool ValidNumber(const wstring& value,
+                 ULONGLONG minimum = 0, ULONGLONG maximum = ULLONG_MAX) {
+  ULONGLONG number = 0;
+  return value.empty() ||
+    (ToNumber(value, number) && minimum <= number && number <= maximum);
+}
+
+// Adds setting NAME to the shim's RCDATA resources, padded with NULs to
+// RESERVE characters like AddResourceData
+void SetSetting(vector<PeResource>& resources, LPCWSTR name,
+                wstring value, size_t reserve = 0) {
+  if (value.size() < reserve)
+    value.resize(reserve, L'\0');
+
+  PeResource resource;
+  resource.type     = PeKey((LPCWSTR)RT_RCDATA);
+  resource.name     = PeKey(name);
+  resource.language = MAKELANGID(LANG_NEUTRAL, SUBLANG_NEUTRAL);
+  resource.data.assign((const BYTE*)value.data(),
+                       (const BYTE*)(value.data() + value.size()));
+  PeSetResource(resources, move(resource));
+}
+
+
+// ------------------------------ Images ----------------------------------- //
+// The module this code lives in: the DLL, or whatever linked the static
+// library
+HMODULE BuilderModule() {
+  HMODULE module = nullptr;
+  GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+                     GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                     (LPCWSTR)&BuilderModule, &module);
+  return module;
+}
+
+// Native machine of this computer, also when this process is emulated (x64
+// on ARM64, where GetNativeSystemInfo reports x64) or runs under WOW64
+WORD HostMachine() {
+  typedef BOOL (WINAPI *IsWow64Process2Func)(HANDLE, USHORT *, USHORT *);
+  auto isWow64Process2 = (IsWow64Process2Func)
+    GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "IsWow64Process2");
+  USHORT process = 0;
+  USHORT native  = 0;
+  if (isWow64Process2 &&
+      isWow64Process2(GetCurrentProcess(), &process, &native))
+    return native;
+
+  SYSTEM_INFO info;
+  GetNativeSystemInfo(&info);
+  switch (info.wProcessorArchitecture) {
+    case PROCESSOR_ARCHITECTURE_INTEL:  return PE_MACHINE_X86;
+    case PROCESSOR_ARCHITECTURE_ARM64:  return PE_MACHINE_ARM64;
+    default:                            return PE_MACHINE_X64;
+  }
+}
+
+// The template for TYPE built for MACHINE (SHIM_<TYPE>_<ARCH>), else the one
+// built with this module (SHIM_<TYPE>)
+bool LoadTemplate(const wstring& type, WORD machine, vector<BYTE>& image) {
+  HMODULE   module      = BuilderModule();
+  string    name        = "SHIM_" + NarrowString(type);
+  shared_ptr<const vector<BYTE>> found;
+  if (const wchar_t* arch = PeMachineName(machine))
+    found = TemplateImage(module, name + "_" + NarrowString(arch));
+  if (!found)
+    found = TemplateImage(module, name);
+  if (!found)
+    return false;
+
+  image = *found;
+  return true;
+}
+
+
+// ------------------------------- Build ----------------------------------- //
+int BuildShim(const ShimBuildConfig& config,
+              const BYTE* source, size_t sourceSize, vector<BYTE>& shim) {
+  wstring path              = Setting(config.path);
+  wstring type              = Setting(CONFIG_FIELD(config, type));
+  wstring args              = Setting(CONFIG_FIELD(config, args));
+  wstring wdType            = Setting(CONFIG_FIELD(config, wdType));
+  wstring wdPath            = Setting(CONFIG_FIELD(config, wdPath));
+  wstring timeout           = Setting(CONFIG_FIELD(config, timeout));
+  wstring timeoutGrace      = Setting(CONFIG_FIELD(config, timeoutGrace));
+  wstring memoryLimit       = Setting(CONFIG_FIELD(config, memoryLimit));
+  wstring jobMemoryLimit    = Setting(CONFIG_FIELD(config, jobMemoryLimit));
+  wstring processLimit      = Setting(CONFIG_FIELD(config, processLimit));
+  wstring cpuRate           = Setting(CONFIG_FIELD(config, cpuRate));
+  wstring priority          = Setting(CONFIG_FIELD(config, priority));
+  wstring affinity          = Setting(CONFIG_FIELD(config, affinity));
+  wstring powerThrottling   = Setting(CONFIG_FIELD(config, powerThrottling));
+  wstring memoryPriority    = Setting(CONFIG_FIELD(config, memoryPriority));
+  wstring ioPriority        = Setting(CONFIG_FIELD(config, ioPriority));
+  wstring tee               = Setting(CONFIG_FIELD(config, tee));
+  wstring jobStats          = Setting(CONFIG_FIELD(config, jobStats));
+  wstring journal           = Setting(CONFIG_FIELD(config, journal));
+  wstring sourceDateEpoch   = Setting(CONFIG_FIELD(config, sourceDateEpoch));
+  wstring interpreter       = Setting(CONFIG_FIELD(config, interpreter));
+  wstring responseFile      = Setting(CONFIG_FIELD(config, responseFile));
+  wstring arch              = Setting(CONFIG_FIELD(config, arch));
+  wstring settings          = Setting(CONFIG_FIELD(config, settings));
+  const void* templateImage = CONFIG_FIELD(config, templateImage);
+  size_t templateSize       = CONFIG_FIELD(config, templateSize);
+
+  if (path.empty())
+    return SHIM_BUILD_INVALID_CONFIG;
+
+  // ---------- Source ---------- //
+  vector<BYTE> sourceImage;
+  if (!source) {
+    if (!ReadFileData(path, sourceImage))
+      return SHIM_BUILD_NO_SOURCE;
+    source      = sourceImage.data();
+    sourceSize  = sourceImage.size();
+  }
+
+  // ---------- Validate ---------- //
+  if (type.empty())
+    type = PeSubsystem(source, sourceSize) == IMAGE_SUBSYSTEM_WINDOWS_GUI ?
+      L"GUI" : L"CONSOLE";
+  UpperCase(type);
+  if (wdType.empty())
+    wdType = type == L"CONSOLE" ? L"CMD" : L"APP";
+  UpperCase(wdType);
+  UpperCase(priority);
+  UpperCase(powerThrottling);
+  UpperCase(memoryPriority);
+  UpperCase(ioPriority);
+  UpperCase(settings);
+  WORD machine = ShimMachine(PeMachine(source, sourceSize), HostMachine(),
+                             arch);
+  // The job takes memory limits in bytes and affinity as a mask, both
+  // pointer sized: an x86 shim holds 4095 MB and 32 processors at most
+  bool      x86         = machine == PE_MACHINE_X86;
+  ULONGLONG maxMemory   = x86 ? MAXDWORD >> 20 : ULLONG_MAX >> 20;
+  ULONGLONG maxAffinity = x86 ? MAXDWORD : ULLONG_MAX;
+
+  if ((type != L"CONSOLE" && type != L"GUI") ||
+      (wdType != L"CMD" && wdType != L"APP" && wdType != L"SHIM" &&
+       wdType != L"PATH") ||
+      !ValidNumber(timeout) || !ValidNumber(timeoutGrace) ||
+      !ValidNumber(memoryLimit, 1, maxMemory) ||
+      !ValidNumber(jobMemoryLimit, 1, maxMemory) ||
+      !ValidNumber(processLimit, 1, MAXDWORD) ||
+      !ValidNumber(cpuRate, 1, 100) ||
+      !ValidNumber(affinity, 1, maxAffinity) ||
+      !ValidNumber(sourceDateEpoch, 0, MAXDWORD) ||
+      !ValidNumber(responseFile, 1, 32767) || !machine ||
+      (!settings.empty() && settings != L"EMBED" && settings != L"SIDECAR") ||
+      (!priority.empty() && !PriorityClass(priority)) ||
+      (!powerThrottling.empty() && PowerThrottling(powerThrottling) < 0) ||
+      (!memoryPriority.empty() && MemoryPriority(memoryPriority) < 0) ||
+      (!ioPriority.empty() && IoPriority(ioPriority) < 0))
+    return SHIM_BUILD_INVALID_CONFIG;
+
+  // ---------- Template ---------- //
+  if (templateImage)
+    shim.assign((const BYTE*)templateImage,
+                (const BYTE*)templateImage + templateSize);
+  else if (!LoadTemplate(type, machine, shim))
+    return SHIM_BUILD_NO_TEMPLATE;
+  wstring templateId = ImageId(shim);
+
+  // The template's own link time is fixed with it (and a hash of its contents
+  // with -Brepro); a given epoch replaces it
+  ULONGLONG epoch = 0;
+  if (ToNumber(sourceDateEpoch, epoch) && !PeSetTimestamp(shim, (DWORD)epoch))
+    return SHIM_BUILD_BAD_TEMPLATE;
+
+  vector<PeResource> resources;
+  if (!PeReadResources(shim.data(), shim.size(), resources))
+    return SHIM_BUILD_BAD_TEMPLATE;
+
+  // ---------- Icons and Version Info ---------- //
+  // Anything but an image (e.g. a batch file) simply has none
+  vector<PeResource> sourceResources;
+  PeReadResources(source, sourceSize, sourceResources);
+  for (PeResource& resource : sourceResources) {
+    if (resource.type.name.empty() &&
+        (resource.type.id == (WORD)(ULONG_PTR)RT_ICON ||
+         resource.type.id == (WORD)(ULONG_PTR)RT_GROUP_ICON ||
+         resource.type.id == (WORD)(ULONG_PTR)RT_VERSION))
+      PeSetResource(resources, move(resource));
+  }
+
+  // ---------- Settings ---------- //
+  SetSetting(resources, L"SHIM_PATH", path, SHIM_BUILD_PATH_RESERVE);
+  SetSetting(resources, L"SHIM_TYPE", type);
+  SetSetting(resources, L"SHIM_TEMPLATE", templateId);
+
+  // The sidecar has the rest; the working directory type is the default, so
+  // the shim does not depend on any setting
+  if (settings == L"SIDECAR") {
+    SetSetting(resources, L"WD_TYPE", type == L"CONSOLE" ? L"CMD" : L"APP");
+    return PeWriteResources(shim, resources) ?
+      SHIM_BUILD_OK : SHIM_BUILD_BAD_TEMPLATE;
+  }
+
+  SetSetting(resources, L"WD_TYPE", wdType);
+  if (wdType == L"PATH" && !wdPath.empty())
+    SetSetting(resources, L"WD_PATH", wdPath, SHIM_BUILD_PATH_RESERVE);
+
+  struct { LPCWSTR name; const wstring& value; } optional[] = {
+    {L"SHIM_ARGS",              args},
+    {L"SHIM_TIMEOUT",           timeout},
+    {L"SHIM_TIMEOUT_GRACE",     timeoutGrace},
+    {L"LIMIT_PROCESS_MEMORY",   memoryLimit},
+    {L"LIMIT_JOB_MEMORY",       jobMemoryLimit},
+    {L"LIMIT_PROCESSES",        processLimit},
+    {L"LIMIT_CPU_RATE",         cpuRate},
+    {L"LIMIT_PRIORITY",         priority},
+    {L"LIMIT_AFFINITY",         affinity},
+    {L"QOS_POWER_THROTTLING",   powerThrottling},
+    {L"QOS_MEMORY_PRIORITY",    memoryPriority},
+    {L"QOS_IO_PRIORITY",        ioPriority},
+    {L"SHIM_TEE",               tee},
+    {L"SHIM_STATS",             jobStats},
+    {L"SHIM_JOURNAL",           journal},
+    {L"SHIM_INTERPRETER",       interpreter},
+    {L"SHIM_RESPONSE_FILE",     responseFile},
+  };
+  for (const auto& setting : optional)
+    if (!setting.value.empty())
+      SetSetting(resources, setting.name, setting.value);
+
+  return PeWriteResources(shim, resources) ?
+    SHIM_BUILD_OK : SHIM_BUILD_BAD_TEMPLATE;
+}
+
+
+// ---------------------------- C Interface -------------------------------- //
+extern "C" SHIM_BUILDER_API int SHIM_BUILDER_CALL
+ShimBuild(const ShimBuildConfig* config,
+          const void* source, size_t source_size,
+          void* output, size_t* size) {
+  if (!config || !size ||
+      config->size < offsetof(ShimBuildConfig, path) + sizeof(config->path))
+    return SHIM_BUILD_INVALID_CONFIG;
+
+  // Nothing may escape into C callers
+  try {
+    vector<BYTE> shim;
+    int result = BuildShim(*config, (const BYTE*)source, source_size, shim);
+    if (result != SHIM_BUILD_OK)
+      return result;
+
+    bool fits = output && *size >= shim.size();
+    if (fits)
+      memcpy(output, shim.data(), shim.size());
+    *size = shim.size();
+    return fits ? SHIM_BUILD_OK : SHIM_BUILD_TOO_SMALL;
+  }
+  catch (const bad_alloc&) {
+    return SHIM_BUILD_NO_MEMORY;
+  }
+  catch (...) {
+    return SHIM_BUILD_FAILED;
+  }
+}
+
+extern "C" SHIM_BUILDER_API const char* SHIM_BUILDER_CALL
+ShimBuildMessage(int result) {
+  switch (result) {
+    case SHIM_BUILD_OK:             return "shim built";
+    case SHIM_BUILD_TOO_SMALL:      return "output buffer too small";
+    case SHIM_BUILD_INVALID_CONFIG: return "invalid configuration";
+    case SHIM_BUILD_NO_SOURCE:      return "could not read the target";
+    case SHIM_BUILD_NO_TEMPLATE:    return "no template for the shim type";
+    case SHIM_BUILD_BAD_TEMPLATE:   return "template is not a usable image";
+    case SHIM_BUILD_NO_MEMORY:      return "out of memory";
+    default:                        return "shim could not be built";
+  }
+}
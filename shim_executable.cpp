@@ -27,13 +27,108 @@
 #include <resource_functions.h>
 #include <get_argument.h>
 #include <utility_functions.h>
+#include <journal.h>
+#include <maintenance_functions.h>
+#include <script_interpreter.h>
+#include <shim_builder.h>
+#include <pe_machine.h>
+#include <serve_functions.h>
+#include <sidecar.h>
+
+#include <map>
 
 #pragma comment(lib, "SHELL32.LIB")
 
 
-// ----------------- Unpack the Shim from this Application ----------------- // 
-BOOL UnpackShim(const filesystem::path& path, wstring shim_type) {
-  return GetResourceFile("SHIM_" + NarrowString(shim_type), path);
+// ------------------- Validate an Optional Number Argument ----------------- //
+bool CheckNumber(const wstring& value, string name,
+                 ULONGLONG minimum = 0, ULONGLONG maximum = ULLONG_MAX) {
+  ULONGLONG number = 0;
+  if (value.empty())
+    return true;
+  if (ToNumber(value, number) && minimum <= number && number <= maximum)
+    return true;
+
+  LOG(1) << name << " must be a whole number between " << minimum
+         << " and " << maximum << " (got '" << value << "')";
+  return false;
+}
+
+
+// ----------------------- Summarize a Launch Journal ---------------------- //
+// Nearest rank percentile of sorted VALUES
+ULONGLONG Percentile(const vector<ULONGLONG>& values, int percent) {
+  if (values.empty())
+    return 0;
+  size_t rank = (values.size() * percent + 99) / 100;
+  return values[rank > 0 ? rank - 1 : 0];
+}
+
+int ShowJournalStats(const wstring& directory) {
+  vector<JournalRecord> records;
+  if (!JournalRead(directory, records)) {
+    LOG(1) << "No launch journal in '" << directory << "'";
+    return 1;
+  }
+
+  struct ShimRuns {
+    wstring             name;
+    ULONGLONG           failed = 0;
+    vector<ULONGLONG>   overhead;         // microseconds
+    vector<ULONGLONG>   duration;         // microseconds, waited runs only
+  };
+  map<ULONGLONG, ShimRuns> shims;
+
+  for (const JournalRecord& record : records) {
+    ShimRuns& runs = shims[record.shimId];
+    runs.name = wstring(record.name, wcsnlen(record.name, JOURNAL_NAME));
+    runs.overhead.push_back(record.overhead);
+    if (record.flags & JOURNAL_WAITED)
+      runs.duration.push_back(record.duration);
+    if (record.exitCode != 0 || (record.flags & JOURNAL_FAILED))
+      runs.failed++;
+  }
+
+  vector<ShimRuns*> order;
+  for (auto& [id, runs] : shims) {
+    sort(runs.overhead.begin(), runs.overhead.end());
+    sort(runs.duration.begin(), runs.duration.end());
+    order.push_back(&runs);
+  }
+  sort(order.begin(), order.end(), [](ShimRuns* a, ShimRuns* b) {
+    return a->overhead.size() > b->overhead.size();
+  });
+
+  char line[256];
+  cout << records.size() << " launches of " << shims.size() << " shims"
+       << endl << endl;
+  snprintf(line, sizeof(line), "%-28s %7s %6s  %-26s %-26s",
+           "SHIM", "RUNS", "FAIL%",
+           "START ms p50/p90/p99", "RUN s p50/p90/p99");
+  cout << line << endl << horizontal_line << endl;
+
+  for (ShimRuns* runs : order) {
+    const vector<ULONGLONG>& start = runs->overhead;
+    const vector<ULONGLONG>& run   = runs->duration;
+    string name = NarrowString(runs->name).substr(0, 28);
+
+    char startText[32], runText[32];
+    snprintf(startText, sizeof(startText), "%.2f/%.2f/%.2f",
+             Percentile(start, 50) / 1e3, Percentile(start, 90) / 1e3,
+             Percentile(start, 99) / 1e3);
+    if (run.empty())
+      snprintf(runText, sizeof(runText), "-");
+    else
+      snprintf(runText, sizeof(runText), "%.2f/%.2f/%.2f",
+               Percentile(run, 50) / 1e6, Percentile(run, 90) / 1e6,
+               Percentile(run, 99) / 1e6);
+
+    snprintf(line, sizeof(line), "%-28s %7zu %5.1f%%  %-26s %-26s",
+             name.c_str(), start.size(),
+             100.0 * runs->failed / start.size(), startText, runText);
+    cout << line << endl;
+  }
+  return 0;
 }
 
 
@@ -49,7 +144,12 @@ void ShowHelp(string exec_name, bool is_shimgen) {
   if(!is_shimgen)
     cout << cmd + " PATH [OUTPUT] [...]" << endl;
   cout << cmd + " -p PATH -o OUTPUT [...]" << endl;
-  cout << cmd + " --path=PATH --output=OUTPUT [...]" << endl << endl << endl;
+  cout << cmd + " --path=PATH --output=OUTPUT [...]" << endl;
+  cout << cmd + " --inspect PATH [PATH...] [--prune] [--report FILE]" << endl;
+  cout << cmd + " --retarget OLD_PREFIX NEW_PREFIX PATH [PATH...]" << endl;
+  cout << cmd + " --upgrade PATH [PATH...]" << endl;
+  cout << cmd + " --stats DIR" << endl;
+  cout << cmd + " --serve" << endl << endl << endl;
 
   // ---------- INFO ---------- //
   cout << horizontal_line << endl;
@@ -220,6 +320,155 @@ will be assumed to be OUTPUT.
     --wd-path PATH      When --wd-type is PATH, use this as the working
                             directory. Ignored otherwise.
 
+    --timeout SECONDS   When the shim waits for the executable, terminate it
+                            and every process it started after SECONDS. The
+                            shim then exits with code 124. Can be overridden
+                            with --shim-Timeout.
+
+    --timeout-grace SECONDS
+                        With --timeout, send Ctrl-Break first and allow the
+                            executable SECONDS to exit before terminating it.
+                            Can be overridden with --shim-TimeoutGrace.
+
+    --memory-limit MB   Limit the committed memory of each process started by
+                            the shim (the executable and its children).
+
+    --job-memory-limit MB
+                        Limit the committed memory of all processes started
+                            by the shim combined.
+
+    --process-limit N   Limit the number of processes that can be running at
+                            once under the shim.
+
+    --cpu-rate PERCENT  Cap the CPU usage of all processes started by the shim
+                            to PERCENT (1-100) of the machine.
+
+    --priority CLASS    Priority class of all processes started by the shim:
+                            IDLE, BELOW_NORMAL, NORMAL, ABOVE_NORMAL or HIGH.
+
+    --affinity MASK     Processor affinity mask (e.g. 0xF) of all processes
+                            started by the shim. An x86 shim takes masks of
+                            up to 32 processors and memory limits of up to
+                            4095 MB.
+
+    --power-throttling ON|OFF
+                        Start the executable with power throttling (EcoQoS)
+                            on, e.g. for indexers and updaters, or explicitly
+                            off (HighQoS) for interactive tools. Can be
+                            overridden with --shim-PowerThrottling.
+
+    --memory-priority LEVEL
+                        Memory priority of the executable: VERY_LOW, LOW,
+                            MEDIUM, BELOW_NORMAL or NORMAL. Can be overridden
+                            with --shim-MemoryPriority.
+
+    --io-priority LEVEL I/O priority of the executable: VERY_LOW, LOW or
+                            NORMAL. Can be overridden with --shim-IoPriority.
+
+    --tee FILE          Copy everything the executable writes to stdout and
+                            stderr into FILE (relative to the directory the
+                            shim is run from). The shim then always waits for
+                            the executable. Can be overridden with --shim-Tee.
+
+    --job-stats TARGET  Report CPU time, peak memory, I/O and process count of
+                            the executable and everything it started when it
+                            exits: STDERR, LOG or the path of a JSON file. Can
+                            be overridden with --shim-Stats.
+
+    --journal DIR       Record every launch of the shim (time, exit code, start
+                            overhead and run time) in DIR\shim_journal.bin, a
+                            ring buffer shared by all shims. The SHIM_JOURNAL
+                            environment variable takes precedence.
+
+    --source-date-epoch SECONDS
+                        Link time written into the shim, in seconds since
+                            1970. Defaults to the SOURCE_DATE_EPOCH environment
+                            variable, else the template's own. The same source,
+                            settings and generator always give the same bytes.
+
+    --interpreter CMD   Command line that starts the script PATH, where %* is
+                            replaced by the quoted script and its arguments
+                            (appended if missing). Found automatically for
+                            .bat and .cmd (%ComSpec% /d /s /c "%*"), .ps1
+                            (powershell -NoProfile -File) and .py / .pyw
+                            (python.exe or the py launcher on the PATH). The
+                            shim starts it directly, without CMD.EXE.
+
+    --response-file CHARS
+                        Pass the arguments in a response file (@FILE in
+                            %TEMP%) when the command line would be longer than
+                            CHARS characters (at most 32767, the CreateProcess
+                            limit). Only for executables that read response
+                            files, e.g. compilers and linkers. The file is
+                            deleted when the executable exits (if the shim
+                            waits). Can be overridden with
+                            --shim-ResponseFile.
+
+    --arch ARCH         Architecture of the shim: TARGET (the default, that of
+                            the executable), HOST (that of this computer),
+                            X86, X64 or ARM64. A shim of another architecture
+                            than the computer's runs emulated, which slows
+                            down every launch. Scripts, executables of other
+                            architectures and AnyCPU .NET executables get the
+                            computer's. Falls back to the architecture this
+                            program was built for if no shim template was
+                            built for ARCH.
+
+    --sidecar           Write the settings above to OUTPUT with the extension
+                            .shim (e.g. app.shim next to app.exe) instead of
+                            embedding them; only the target path is embedded,
+                            as a fallback. The shim reads the sidecar first on
+                            every launch, so settings can be edited (or the
+                            target moved) without rewriting the shim and having
+                            it scanned again. The format is Scoop's
+                            (path = ..., args = ..., one KEY = VALUE per line,
+                            keys named like these options without dashes).
+                            Without --sidecar, an existing sidecar of OUTPUT is
+                            removed.
+
+    --stats DIR         Summarize the launch journal in DIR per shim: launches,
+                            failure rate and start / run time percentiles.
+                            No shim is created.
+
+    --serve             Create shims on request until stdin is closed. Every
+                            line of stdin is a JSON object with the arguments
+                            named without dashes ("path", "output", "gui",
+                            "timeout", ...) and an optional "id"; every line of
+                            stdout answers one of them with its "id", "ok" and
+                            the "output" path or an "error". Requests run in
+                            parallel and may be answered out of order.
+
+    --inspect PATH...   Audit existing shims instead of creating one. Every
+                            PATH is a shim or a directory searched recursively
+                            for them. Their settings are read without running
+                            them and a JSON report lists them as valid, stale
+                            (target changed after the shim was created, or
+                            working directory missing) or broken (target or
+                            the interpreter of a script missing). Exits with
+                            1 if broken shims are left.
+
+    --prune             With --inspect, delete the broken shims.
+
+    --retarget OLD_PREFIX NEW_PREFIX PATH...
+                        Point existing shims whose target (or working directory
+                            path) starts with OLD_PREFIX at NEW_PREFIX instead,
+                            e.g. after a toolchain moved to a new version
+                            directory. Every PATH is a shim or a directory
+                            searched recursively. Only the embedded paths are
+                            rewritten, in place when they fit, and each shim is
+                            replaced as a whole. Shims with a sidecar are left
+                            as they are and their sidecar is rewritten.
+
+    --upgrade PATH...   Re-wrap existing shims built by an older version of
+                            this program in its current shim template, keeping
+                            their settings, icons and version info. Shims are
+                            stamped with the build ID of their template, so
+                            those already current are left alone. Every PATH
+                            is a shim or a directory searched recursively.
+
+    --report FILE       With --inspect, write the report to FILE instead of
+                            the console.
+
     --debug             Print additional information when creating the shim to
                             the console.
 )V0G0N";
@@ -248,8 +497,8 @@ int wmain(int argc, wchar_t* argv[], wchar_t* envp[]) {
   // executable named as such, we'll handle the magic for the user
   bool is_shimgen           = exec_name.compare(L"SHIMGEN") == 0;
 
-  wstring calling_cmd       = GetCommandLineW();
-  vector<wstring> arg_list  = ParseArguments(calling_cmd);
+  ArgumentList arg_list     = ParseArguments(GetCommandLineW());
+  wstring calling_cmd       = L"";
   GetArgument(arg_list, 0, calling_cmd);
 
   wstring output            = L"";
@@ -259,6 +508,25 @@ int wmain(int argc, wchar_t* argv[], wchar_t* envp[]) {
   wstring shim_type         = L"";
   wstring wd_type           = L"";
   wstring wd_path           = L"";
+  wstring timeout           = L"";
+  wstring timeout_grace     = L"";
+  wstring memory_limit      = L"";
+  wstring job_memory_limit  = L"";
+  wstring process_limit     = L"";
+  wstring cpu_rate          = L"";
+  wstring priority          = L"";
+  wstring affinity          = L"";
+  wstring power_throttling  = L"";
+  wstring memory_priority   = L"";
+  wstring io_priority       = L"";
+  wstring tee               = L"";
+  wstring job_stats         = L"";
+  wstring journal           = L"";
+  wstring source_date_epoch = GetEnvironment(L"SOURCE_DATE_EPOCH");
+  wstring interpreter       = L"";
+  wstring response_file     = L"";
+  wstring arch              = L"";
+  bool sidecar              = false;
   bool debug                = false;
 
   
@@ -270,6 +538,71 @@ int wmain(int argc, wchar_t* argv[], wchar_t* envp[]) {
   if(GetArgument(arg_list, L"-(\\?|h|-help)"))
     ShowHelp(NarrowString(exec_name), is_shimgen);
 
+  // Debug Info, before the commands below so they log at the same level
+  //       --debug
+  debug = GetArgument(arg_list, L"--debug");
+  if (!debug) LOGCFG.level = 1;
+  else LOGCFG.level = 3;      // ignore level 4+
+
+  // Summarize a launch journal instead of creating a shim
+  //       --stats DIR
+  wstring journal_stats     = L"";
+  if (GetArgument(arg_list, L"--stats", journal_stats)) {
+    TrimQuotes(journal_stats);
+    return ShowJournalStats(journal_stats);
+  }
+
+  // Create shims on request from stdin
+  //       --serve
+  if (GetArgument(arg_list, L"--serve"))
+    return Serve();
+
+  // Audit existing shims instead of creating one
+  //       --inspect PATH [PATH...] [--prune] [--report FILE]
+  if (GetArgument(arg_list, L"--inspect")) {
+    bool prune              = GetArgument(arg_list, L"--prune");
+    wstring report          = L"";
+    GetArgument(arg_list, L"--report", report);
+    TrimQuotes(report);
+
+    // Whatever is left are the paths
+    vector<wstring> paths = GetRemainingArguments(arg_list);
+    if (paths.empty()) {
+      LOG(1) << "INSPECT needs at least one shim or directory";
+      return exitcode;
+    }
+    return InspectShims(paths, prune, report);
+  }
+
+  // Rewrite the target of existing shims instead of creating one
+  //       --retarget OLD_PREFIX NEW_PREFIX PATH [PATH...]
+  wstring old_prefix        = L"";
+  if (GetArgument(arg_list, L"--retarget", old_prefix)) {
+    TrimQuotes(old_prefix);
+
+    vector<wstring> args = GetRemainingArguments(arg_list);
+    if (old_prefix.empty() || args.size() < 2) {
+      LOG(1) << "RETARGET needs OLD_PREFIX, NEW_PREFIX and at least one "
+             << "shim or directory";
+      return exitcode;
+    }
+
+    wstring new_prefix = args.front();
+    args.erase(args.begin());
+    return RetargetShims(old_prefix, new_prefix, args);
+  }
+
+  // Move existing shims to the current template instead of creating one
+  //       --upgrade PATH [PATH...]
+  if (GetArgument(arg_list, L"--upgrade")) {
+    vector<wstring> paths = GetRemainingArguments(arg_list);
+    if (paths.empty()) {
+      LOG(1) << "UPGRADE needs at least one shim or directory";
+      return exitcode;
+    }
+    return UpgradeShims(paths);
+  }
+
   // Get Input Path
   //   -p, --path=VALUE
   GetArgument(arg_list, L"-(p|-path)", input);
@@ -294,12 +627,47 @@ int wmain(int argc, wchar_t* argv[], wchar_t* envp[]) {
   // Working directory type and path
   GetArgument(arg_list, L"-(wd-type)", wd_type);
   GetArgument(arg_list, L"-(wd-path)", wd_path);
-  
-  // Debug Info
-  //       --debug
-  debug = GetArgument(arg_list, L"--debug");
-  if (!debug) LOGCFG.level = 1;
-  else LOGCFG.level = 3;      // ignore level 4+
+
+  // Timeout and grace period in seconds
+  GetArgument(arg_list, L"--timeout", timeout);
+  GetArgument(arg_list, L"--timeout-grace", timeout_grace);
+
+  // Job limits
+  GetArgument(arg_list, L"--memory-limit", memory_limit);
+  GetArgument(arg_list, L"--job-memory-limit", job_memory_limit);
+  GetArgument(arg_list, L"--process-limit", process_limit);
+  GetArgument(arg_list, L"--cpu-rate", cpu_rate);
+  GetArgument(arg_list, L"--priority", priority);
+  GetArgument(arg_list, L"--affinity", affinity);
+
+  // Power throttling, memory and I/O priority
+  GetArgument(arg_list, L"--power-throttling", power_throttling);
+  GetArgument(arg_list, L"--memory-priority", memory_priority);
+  GetArgument(arg_list, L"--io-priority", io_priority);
+
+  // Copy of the executable's output
+  GetArgument(arg_list, L"--tee", tee);
+
+  // Resource usage report
+  GetArgument(arg_list, L"--job-stats", job_stats);
+
+  // Launch journal directory
+  GetArgument(arg_list, L"--journal", journal);
+
+  // Link time written into the shim
+  GetArgument(arg_list, L"--source-date-epoch", source_date_epoch);
+
+  // Interpreter of a script
+  GetArgument(arg_list, L"--interpreter", interpreter);
+
+  // Long command lines in a response file
+  GetArgument(arg_list, L"--response-file", response_file);
+
+  // Architecture of the shim
+  GetArgument(arg_list, L"--arch", arch);
+
+  // Settings in <OUTPUT>.shim instead of the shim
+  sidecar = GetArgument(arg_list, L"--sidecar");
 
   
   // ------------------------------------------ //
@@ -325,18 +693,14 @@ int wmain(int argc, wchar_t* argv[], wchar_t* envp[]) {
     if(input.empty())
       GetArgument(arg_list, L"--input", input);
     //   ... or if all else fails, use the first argument
-    if(input.empty()) {
-      ReparseArguments(arg_list);
+    if(input.empty())
       GetArgument(arg_list, 0, input);
-    }
   
     // Additital Output Path Method  
     // technically we have parsed all the valid arguments, so we'll assume if
     // there is one left, it is the output path 
-    if(output.empty()) {
-      ReparseArguments(arg_list);
+    if(output.empty())
       GetArgument(arg_list, 0, output);
-    }
   }
 
   if (!CollapseArguments(arg_list).empty()) {
@@ -350,7 +714,26 @@ int wmain(int argc, wchar_t* argv[], wchar_t* envp[]) {
   TrimQuotes(command_args);
   TrimQuotes(wd_type);
   TrimQuotes(wd_path);
+  TrimQuotes(timeout);
+  TrimQuotes(timeout_grace);
+  TrimQuotes(memory_limit);
+  TrimQuotes(job_memory_limit);
+  TrimQuotes(process_limit);
+  TrimQuotes(cpu_rate);
+  TrimQuotes(priority);
+  TrimQuotes(affinity);
+  TrimQuotes(power_throttling);
+  TrimQuotes(memory_priority);
+  TrimQuotes(io_priority);
+  TrimQuotes(tee);
+  TrimQuotes(job_stats);
+  TrimQuotes(journal);
+  TrimQuotes(source_date_epoch);
+  TrimQuotes(interpreter);
+  TrimQuotes(response_file);
+  TrimQuotes(arch);
   command_args = UnquoteString(command_args);
+  interpreter = UnquoteString(interpreter);
 
   // Debug Info
   LOG(4) << "exec_name:       " << exec_name;
@@ -365,6 +748,25 @@ int wmain(int argc, wchar_t* argv[], wchar_t* envp[]) {
   LOG(4) << "shim_type:       " << shim_type;
   LOG(4) << "wd_type:         " << wd_type;
   LOG(4) << "wd_path:         " << wd_path;
+  LOG(4) << "timeout:         " << timeout;
+  LOG(4) << "timeout_grace:   " << timeout_grace;
+  LOG(4) << "memory_limit:    " << memory_limit;
+  LOG(4) << "job_memory_limit:" << job_memory_limit;
+  LOG(4) << "process_limit:   " << process_limit;
+  LOG(4) << "cpu_rate:        " << cpu_rate;
+  LOG(4) << "priority:        " << priority;
+  LOG(4) << "affinity:        " << affinity;
+  LOG(4) << "power_throttling:" << power_throttling;
+  LOG(4) << "memory_priority: " << memory_priority;
+  LOG(4) << "io_priority:     " << io_priority;
+  LOG(4) << "tee:             " << tee;
+  LOG(4) << "job_stats:       " << job_stats;
+  LOG(4) << "journal:         " << journal;
+  LOG(4) << "source_epoch:    " << source_date_epoch;
+  LOG(4) << "interpreter:     " << interpreter;
+  LOG(4) << "response_file:   " << response_file;
+  LOG(4) << "arch:            " << arch;
+  LOG(4) << "sidecar:         " << sidecar;
   LOG(4) << "debug:           " << debug;
 
 
@@ -447,11 +849,16 @@ int wmain(int argc, wchar_t* argv[], wchar_t* envp[]) {
     return exitcode;
   }
 
+  // Scripts are started by their interpreter, looked up now unless given
+  if (interpreter.empty())
+    interpreter = ScriptInterpreter(input_path);
+
   // Check if EXECUTABLE
   DWORD execType =
     SHGetFileInfoW(input_path.c_str(), NULL, NULL, NULL, SHGFI_EXETYPE);
-  if (execType == 0) {
-    LOG(1) << "SOURCE, " << input_path.filename() << ", must be an executable";
+  if (execType == 0 && interpreter.empty()) {
+    LOG(1) << "SOURCE, " << input_path.filename() << ", must be an executable "
+           << "or a script (.bat, .cmd, .ps1, .py)";
     return exitcode;
   }
 
@@ -464,8 +871,15 @@ int wmain(int argc, wchar_t* argv[], wchar_t* envp[]) {
     LOG(-3) << "Windows GUI application";
   else if (LOWORD(execType) == 0x5A4D)
     LOG(-3) << "MS-DOS application";
-  else
+  else if (execType != 0)
     LOG(-3) << "Windows Console application (or .bat)";    
+  else
+    LOG(-3) << "Script";
+
+  if (!interpreter.empty()) {
+    LOG(3)  << "INTERPRETER: ";
+    LOG(-3) << interpreter;
+  }
 
 
   
@@ -535,6 +949,70 @@ int wmain(int argc, wchar_t* argv[], wchar_t* envp[]) {
   if (wd_type == L"PATH" && wd_path.empty())
     LOG(2) << "WD_TYPE is PATH but WD_PATH is empty; shim will use shim directory";
   
+  // ---------- Timeout ---------- //
+  if (!CheckNumber(timeout, "TIMEOUT") ||
+      !CheckNumber(timeout_grace, "TIMEOUT-GRACE"))
+    return exitcode;
+  if (!timeout_grace.empty() && timeout.empty())
+    LOG(2) << "TIMEOUT-GRACE has no effect without TIMEOUT";
+
+  // ---------- Job Limits ---------- //
+  // An x86 shim holds less, which the builder checks once it knows the
+  // template
+  if (!CheckNumber(memory_limit, "MEMORY-LIMIT", 1, ULLONG_MAX >> 20) ||
+      !CheckNumber(job_memory_limit, "JOB-MEMORY-LIMIT", 1, ULLONG_MAX >> 20) ||
+      !CheckNumber(process_limit, "PROCESS-LIMIT", 1, MAXDWORD) ||
+      !CheckNumber(cpu_rate, "CPU-RATE", 1, 100) ||
+      !CheckNumber(affinity, "AFFINITY", 1))
+    return exitcode;
+
+  if (!priority.empty() && !PriorityClass(priority)) {
+    LOG(1) << "PRIORITY must be IDLE, BELOW_NORMAL, NORMAL, ABOVE_NORMAL "
+           << "or HIGH (got '" << priority << "')";
+    return exitcode;
+  }
+  UpperCase(priority);
+
+  // ---------- Power Throttling, Memory and I/O Priority ---------- //
+  if (!power_throttling.empty() && PowerThrottling(power_throttling) < 0) {
+    LOG(1) << "POWER-THROTTLING must be ON or OFF (got '"
+           << power_throttling << "')";
+    return exitcode;
+  }
+  if (!memory_priority.empty() && MemoryPriority(memory_priority) < 0) {
+    LOG(1) << "MEMORY-PRIORITY must be VERY_LOW, LOW, MEDIUM, BELOW_NORMAL "
+           << "or NORMAL (got '" << memory_priority << "')";
+    return exitcode;
+  }
+  if (!io_priority.empty() && IoPriority(io_priority) < 0) {
+    LOG(1) << "IO-PRIORITY must be VERY_LOW, LOW or NORMAL (got '"
+           << io_priority << "')";
+    return exitcode;
+  }
+  UpperCase(power_throttling);
+  UpperCase(memory_priority);
+  UpperCase(io_priority);
+
+  // ---------- Reproducibility ---------- //
+  if (!CheckNumber(source_date_epoch, "SOURCE-DATE-EPOCH", 0, MAXDWORD))
+    return exitcode;
+
+  // ---------- Response File ---------- //
+  if (!CheckNumber(response_file, "RESPONSE-FILE", 1, 32767))
+    return exitcode;
+
+  // ---------- Architecture ---------- //
+  if (!ShimMachine(0, 0, arch)) {
+    LOG(1) << "ARCH must be TARGET, HOST, X86, X64 or ARM64 (got '"
+           << arch << "')";
+    return exitcode;
+  }
+  UpperCase(arch);
+  if (!arch.empty()) {
+    LOG(3)  << "SHIM ARCHITECTURE: ";
+    LOG(-3) << arch;
+  }
+
   // ---------- Icon Path ---------- // 
   if (!icon.empty())
     LOG(2) << "Specifying alternative icon not implemented, ignoring";
@@ -551,31 +1029,67 @@ int wmain(int argc, wchar_t* argv[], wchar_t* envp[]) {
   // Build Shim                                                              // 
   // ----------------------------------------------------------------------- //
 
-  // ---------- Unpack / Create Shim ---------- // 
-  if (!UnpackShim(output_path, shim_type)) {
-    LOG(1) << "Could not unpack shim";
+  // ---------- Build in Memory ---------- //
+  wstring source            = input_path.wstring();
+  ShimBuildConfig config    = {sizeof(config)};
+  config.path               = source.c_str();
+  config.type               = shim_type.c_str();
+  config.args               = command_args.c_str();
+  config.wdType             = wd_type.c_str();
+  config.wdPath             = wd_path.c_str();
+  config.timeout            = timeout.c_str();
+  config.timeoutGrace       = timeout_grace.c_str();
+  config.memoryLimit        = memory_limit.c_str();
+  config.jobMemoryLimit     = job_memory_limit.c_str();
+  config.processLimit       = process_limit.c_str();
+  config.cpuRate            = cpu_rate.c_str();
+  config.priority           = priority.c_str();
+  config.affinity           = affinity.c_str();
+  config.powerThrottling    = power_throttling.c_str();
+  config.memoryPriority     = memory_priority.c_str();
+  config.ioPriority         = io_priority.c_str();
+  config.tee                = tee.c_str();
+  config.jobStats           = job_stats.c_str();
+  config.journal            = journal.c_str();
+  config.sourceDateEpoch    = source_date_epoch.c_str();
+  config.interpreter        = interpreter.c_str();
+  config.responseFile       = response_file.c_str();
+  config.arch               = arch.c_str();
+  config.settings           = sidecar ? L"SIDECAR" : L"EMBED";
+
+  vector<BYTE> shim;
+  int result = ShimBuild(config, NULL, 0, shim);
+  if (result != SHIM_BUILD_OK) {
+    LOG(1) << "Could not build shim: " << ShimBuildMessage(result);
     return exitcode;
   }
-  
-  LOG(3) << "Created shim, " << output_path.filename()
-         << ", from SHIM_" << shim_type << ".EXE";
 
+  LOG(3) << "Built shim from SHIM_" << shim_type << ".EXE with the icons "
+         << "and version info of " << input_path.filename();
 
-  // ---------- Copy and Add Resources ---------- // 
-  CopyResources(output_path, input_path);    
 
-  // Add Shim Arguments
-  AddResourceData(output_path, "SHIM_PATH", input_path);
-  AddResourceData(output_path, "SHIM_TYPE", shim_type);
-  AddResourceData(output_path, "WD_TYPE", wd_type);
-  if (wd_type == L"PATH" && !wd_path.empty())
-    AddResourceData(output_path, "WD_PATH", wd_path);
-  if (!command_args.empty()) 
-    AddResourceData(output_path, "SHIM_ARGS", command_args);
+  // ---------- Write Shim ---------- //
+  if (!WriteFileData(output_path, shim)) {
+    LOG(1) << "Could not write shim";
+    return exitcode;
+  }
+
+  // ---------- Sidecar ---------- //
+  // Written with the settings, or an old one removed as it would override
+  // those just embedded
+  if (!UpdateSidecar(output_path, config)) {
+    LOG(1) << "Could not " << (sidecar ? "write " : "remove ")
+           << SidecarPath(output_path);
+    return exitcode;
+  }
+  if (sidecar) {
+    LOG(3)  << "SIDECAR: ";
+    LOG(-3) << SidecarPath(output_path);
+  }
 
 
   // -------------------------------- Done --------------------------------- // 
   LOG() << exec_name << " has successfully created " << output_path;
-  return exitcode;
+  return 0;
 }
  
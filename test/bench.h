@@ -0,0 +1,83 @@
+// ------------------------------------------------------------------------- //
+// Benchmark Helpers                                                         //
+// ------------------------------------------------------------------------- //
+// What the benchmarks share: their --NAME VALUE options, the directory a
+// run works in, medians and timing a run. Quoting strings for the JSON reports is JsonString of
+// UTILITY_FUNCTIONS.H, included on Windows; everything else only needs the
+// standard library, so bench_arguments still builds on any platform.
+// ------------------------------------------------------------------------- //
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+#include <filesystem>
+#include <system_error>
+#ifdef _WIN32
+#include <utility_functions.h>
+#endif
+
+using namespace std;
+
+
+// The --NAME VALUE pairs from ARGV[FIRST] on; exits if the last one lacks
+// its value
+template <class Char>
+vector<pair<basic_string<Char>, basic_string<Char>>> BenchOptions(
+    int argc, Char* argv[], int first) {
+  vector<pair<basic_string<Char>, basic_string<Char>>> options;
+  for (int i = first; i < argc; i += 2) {
+    if (i + 1 == argc) {
+      cerr << "The last option has no value\n";
+      exit(1);
+    }
+    options.push_back({argv[i], argv[i + 1]});
+  }
+  return options;
+}
+
+// A new, empty directory for one run under OUT, which is created if needed.
+// The run deletes this one when done and never touches OUT or anything that
+// was already in it. Exits if none can be created.
+inline filesystem::path BenchDirectory(const filesystem::path& out) {
+  error_code error;
+  filesystem::create_directories(out, error);
+  for (int i = 0; i < 1000; i++) {
+    filesystem::path run = out / ("run-" + to_string(i));
+    if (filesystem::create_directory(run, error))
+      return run;
+  }
+  cerr << "Could not create a directory in " << out.string() << "\n";
+  exit(1);
+}
+
+// Median of VALUES, 0 if there are none
+inline double Median(vector<double> values) {
+  sort(values.begin(), values.end());
+  return values.empty() ? 0 : values[values.size() / 2];
+}
+
+// Median microseconds of RUN after WARMUP runs that are not measured, -1 if
+// it ever fails
+inline double Time(const function<bool()>& run, int runs, int warmup = 3) {
+  vector<double> samples;
+  for (int i = 0; i < warmup + runs; i++) {
+    auto start = chrono::steady_clock::now();
+    bool ok = run();
+    auto stop = chrono::steady_clock::now();
+    if (!ok)
+      return -1;
+    if (i >= warmup)
+      samples.push_back(
+        chrono::duration<double, micro>(stop - start).count());
+  }
+  return Median(samples);
+}
+
+#endif  // BENCH_H
@@ -0,0 +1,284 @@
+// ------------------------------------------------------------------------- //
+// Argument Parser Microbenchmark                                            //
+// ------------------------------------------------------------------------- //
+// Times the functions of GET_ARGUMENT.H that run at every shim's startup on
+// a set of realistic command lines, and counts the heap allocations each
+// makes. The "Startup" operation is ReadShimArguments of SHIM_ARGUMENTS.H,
+// the whole sequence shim.cpp runs before starting its target: skipping the
+// program name, looking for --shim flags and, if there are any, parsing,
+// taking every flag and collapsing the rest.
+//
+// Usage:
+//   bench_arguments [--report FILE] [--runs N] [--min-ms N] [--filter TEXT]
+//
+// The report is JSON (stdout unless --report is given) with the median
+// ns/op, allocations/op and bytes allocated/op of every case and operation,
+// so two versions of the parser can be diffed. --filter only runs the cases
+// or operations containing TEXT.
+//
+// Builds with MSVC (nmake bench), mingw (runs under Wine) and, needing only
+// the standard library off Windows, on Linux, e.g.
+//   g++ -std=c++17 -O2 -I../include bench_arguments.cpp -o bench_arguments
+// wchar_t is 32 bits on Linux, where the prefix scan takes its scalar path,
+// so only compare figures from the same platform.
+// ------------------------------------------------------------------------- //
+#include <shim_arguments.h>
+#include "bench.h"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+using namespace chrono;
+
+#define PROGRAM         L"\"C:\\Program Files\\Tools\\app.exe\" "
+#define BATCH           64            // argument lists prepared at a time
+
+#ifdef _MSC_VER
+#define NOINLINE        __declspec(noinline)
+#else
+#define NOINLINE        __attribute__((noinline))
+#endif
+
+
+// ----------------------------- Allocations ------------------------------- //
+// Every allocation goes through the replaced global operator new, which
+// counts it. The benchmark is single threaded, so plain counters do.
+static size_t allocations     = 0;
+static size_t allocated_bytes = 0;
+
+// Not inlined, so the compiler cannot pair a new expression with the free
+// below and warn about mismatched allocation functions
+NOINLINE void* operator new(size_t size) {
+  allocations++;
+  allocated_bytes += size;
+  if (void* p = malloc(size ? size : 1))
+    return p;
+  throw bad_alloc();
+}
+NOINLINE void* operator new[](size_t size) {
+  return operator new(size);
+}
+NOINLINE void  operator delete(void* p) noexcept           { free(p); }
+NOINLINE void  operator delete[](void* p) noexcept         { free(p); }
+NOINLINE void  operator delete(void* p, size_t) noexcept   { free(p); }
+NOINLINE void  operator delete[](void* p, size_t) noexcept { free(p); }
+
+// Keeps results alive so the optimizer cannot drop the work
+static volatile size_t sink = 0;
+
+
+// ---------------------------- Command Lines ------------------------------ //
+struct Case {
+  string    name;
+  wstring   line;                     // as GetCommandLineW() returns it
+};
+
+// Repeats FRAGMENTS in turn until the arguments are LENGTH characters, then
+// appends TAIL
+wstring Fill(const vector<wstring>& fragments, size_t length,
+             const wstring& tail) {
+  wstring line = PROGRAM;
+  size_t target = length > tail.size() ? length - tail.size() : 0;
+  for (size_t i = 0; line.size() - wcslen(PROGRAM) < target; i++) {
+    wstring fragment = fragments[i % fragments.size()];
+    size_t at = fragment.find(L'#');
+    if (at != wstring::npos)
+      fragment.replace(at, 1, to_wstring(i));
+    line += fragment + L" ";
+  }
+  return line + tail;
+}
+
+vector<Case> Cases() {
+  vector<Case> cases;
+
+  cases.push_back({"no-flags", PROGRAM
+    L"build --config Release -j 8 \"C:\\src\\my project\\app.sln\""});
+
+  cases.push_back({"shim-flags", PROGRAM
+    L"--shim-WdType Target --shim-WdPath \"C:\\work dir\" "
+    L"--shim-Timeout 30 --shim-TimeoutGrace 5 --shim-PowerThrottling Off "
+    L"--shim-MemoryPriority Low --shim-IoPriority Low "
+    L"--shim-Tee \"C:\\logs\\app.log\" --shim-Stats stats.json "
+    L"--shim-ResponseFile 8191 --shim-Log --shim-Wait --shim-Exit "
+    L"build --config Release \"C:\\src\\my project\\app.sln\""});
+
+  // Quotes inside words, escaped quotes and runs of backslashes, some of
+  // which escape a quote and some of which do not
+  cases.push_back({"deep-quoting", Fill({
+    L"\"C:\\dir with spaces\\sub dir\\\\\"",
+    L"--define=\"NAME=\\\"a b c\\\"\"",
+    L"\"\\\\server\\share\\\\\\\"quoted\\\\\\\" part\\\\\"",
+    L"arg\"with\"quotes",
+    L"\"a \\\\\\\"b\\\\\\\" c\"",
+    L"--opt=\"x y\"=z",
+    L"\\\\\\\\\"\"\\\\\"" }, 1024, L"--shim-Timeout 30")});
+
+  // Long lines of file arguments, as build tools and linters pass them, with
+  // one flag at the end so the whole line is parsed
+  vector<wstring> files = {
+    L"C:\\src\\project\\module\\file_#.cpp",
+    L"\"C:\\src\\my project\\include\\header_#.h\"",
+    L"-DFEATURE_#=1",
+    L"--output=C:\\build\\obj\\file_#.obj" };
+  for (auto [name, length] : {pair<const char*, size_t>{"length-1k", 1024},
+                                {"length-8k", 8192},
+                                {"length-32k", 32000}})
+    cases.push_back({name, Fill(files, length, L"--shim-Timeout 30")});
+
+  return cases;
+}
+
+
+// ------------------------------ Operations ------------------------------- //
+// The argument handling of shim.cpp's main, start to finish
+size_t Startup(wstring_view line) {
+  ShimArguments shim;
+  ReadShimArguments(line, shim);
+  return shim.log + shim.wait + shim.exit + shim.gui + shim.noop + shim.help +
+         shim.timeout.size() + shim.callingArgs.size();
+}
+
+struct Operation {
+  string    name;
+  bool      mutates;                  // needs a fresh argument list each time
+  size_t    (*run)(const Case&, ArgumentList&);
+};
+
+vector<Operation> Operations() {
+  return {
+    {"ArgumentTail", false, [](const Case& c, ArgumentList&) {
+      return ArgumentTail(c.line).size(); }},
+    {"ContainsPrefix", false, [](const Case& c, ArgumentList&) {
+      return (size_t)ContainsPrefix(c.line, SHIM_ARG_PREFIX); }},
+    {"ParseArguments", false, [](const Case& c, ArgumentList&) {
+      return ParseArguments(ArgumentTail(c.line)).size(); }},
+    {"CollapseArguments", false, [](const Case&, ArgumentList& args) {
+      return CollapseArguments(args).size(); }},
+    {"GetArgument(flag)", true, [](const Case&, ArgumentList& args) {
+      return (size_t)GetShimArg(args, L'w'); }},
+    {"GetArgument(value)", true, [](const Case&, ArgumentList& args) {
+      wstring value;
+      return GetArgument(args, L"--shim-timeout", value) + value.size(); }},
+    {"GetArgument(index)", true, [](const Case&, ArgumentList& args) {
+      wstring value;
+      return GetArgument(args, 0, value) + value.size(); }},
+    {"Startup", false, [](const Case& c, ArgumentList&) {
+      return Startup(c.line); }},
+  };
+}
+
+
+// -------------------------------- Timing --------------------------------- //
+struct Sample {
+  double    ns = 0;
+  double    allocs = 0;
+  double    bytes = 0;
+};
+
+// Runs OP ITERATIONS times. Argument lists for the operations that change
+// them are copied in batches outside of the timed (and counted) part.
+Sample Run(const Case& c, const Operation& op, const ArgumentList& parsed,
+           size_t iterations) {
+  vector<ArgumentList> lists;
+  Sample sample;
+  size_t done = 0;
+  while (done < iterations) {
+    size_t batch = op.mutates ? min<size_t>(BATCH, iterations - done) :
+                                iterations - done;
+    lists.assign(op.mutates ? batch : 1, parsed);
+
+    size_t count = allocations;
+    size_t bytes = allocated_bytes;
+    auto start = steady_clock::now();
+    for (size_t i = 0; i < batch; i++)
+      sink += op.run(c, lists[op.mutates ? i : 0]);
+    auto stop = steady_clock::now();
+
+    sample.ns     += duration<double, nano>(stop - start).count();
+    sample.allocs += allocations - count;
+    sample.bytes  += allocated_bytes - bytes;
+    done += batch;
+  }
+  sample.ns     /= iterations;
+  sample.allocs /= iterations;
+  sample.bytes  /= iterations;
+  return sample;
+}
+
+// Median of RUNS runs, each long enough to take at least MIN_MS
+Sample Measure(const Case& c, const Operation& op, int runs, int min_ms) {
+  ArgumentList parsed = ParseArguments(ArgumentTail(c.line));
+
+  size_t iterations = 1;
+  for (;;) {
+    Sample sample = Run(c, op, parsed, iterations);
+    if (sample.ns * iterations >= min_ms * 1e6 || iterations >= (1u << 30))
+      break;
+    iterations *= 2;
+  }
+
+  vector<Sample> samples;
+  for (int i = 0; i < runs; i++)
+    samples.push_back(Run(c, op, parsed, iterations));
+  sort(samples.begin(), samples.end(),
+       [](const Sample& a, const Sample& b) { return a.ns < b.ns; });
+  return samples[samples.size() / 2];
+}
+
+
+// ------------------------------------------------------------------------- //
+int main(int argc, char* argv[]) {
+  string report;
+  string filter;
+  int    runs   = 5;
+  int    min_ms = 100;
+
+  for (auto& [flag, value] : BenchOptions(argc, argv, 1)) {
+    if (flag == "--report")  report = value;
+    if (flag == "--runs")    runs = max(1, atoi(value.c_str()));
+    if (flag == "--min-ms")  min_ms = max(1, atoi(value.c_str()));
+    if (flag == "--filter")  filter = value;
+  }
+
+  ostringstream json;
+  json << "{\n  \"runs\": " << runs << ",\n  \"results\": [";
+  bool first = true;
+
+  for (const Case& c : Cases()) {
+    for (const Operation& op : Operations()) {
+      if (!filter.empty() && c.name.find(filter) == string::npos &&
+          op.name.find(filter) == string::npos)
+        continue;
+
+      Sample sample = Measure(c, op, runs, min_ms);
+      json << (first ? "\n" : ",\n")
+           << "    {\"case\": \"" << c.name << "\""
+           << ", \"length\": " << c.line.size()
+           << ", \"op\": \"" << op.name << "\""
+           << ", \"ns_per_op\": " << (long long)(sample.ns + 0.5)
+           << ", \"allocs_per_op\": " << sample.allocs
+           << ", \"bytes_per_op\": " << (long long)(sample.bytes + 0.5) << "}";
+      first = false;
+
+      cerr << c.name << string(14 - min<size_t>(13, c.name.size()), ' ')
+           << op.name << string(20 - min<size_t>(19, op.name.size()), ' ')
+           << (long long)(sample.ns + 0.5) << " ns/op, "
+           << sample.allocs << " allocs/op\n";
+    }
+  }
+  json << "\n  ]\n}\n";
+
+  if (report.empty())
+    cout << json.str();
+  else
+    ofstream(report) << json.str();
+  return 0;
+}
@@ -0,0 +1,208 @@
+// ------------------------------------------------------------------------- //
+// Waiting Shim Footprint Benchmark                                          //
+// ------------------------------------------------------------------------- //
+// Generates a shim for this program and starts many copies of it at once.
+// Every target holds until all of them are running; the shims are then
+// blocked waiting for their targets, which is where a console shim spends its
+// life. The private bytes (commit charge) and working set of each waiting
+// shim are read and summarized.
+//
+// Usage:
+//   bench_footprint.exe SHIM_EXEC [--out DIR] [--report FILE] [--count N]
+//                       [--target KB]
+//
+// The report is JSON (stdout unless --report is given) and fails (exit code
+// 1) if the average private bytes exceed the target, 200 KB by default. Runs
+// headless, natively or under Wine. The shim lives in a new run-N directory
+// in DIR for the duration.
+// ------------------------------------------------------------------------- //
+#include <windows.h>
+#include <psapi.h>
+#include "bench.h"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+
+#pragma comment(lib, "PSAPI.LIB")
+
+using namespace std;
+using namespace filesystem;
+
+#define SETTLE_MS     1000            // for the shims to reach their wait
+#define START_TIMEOUT 60000
+
+struct Footprint {
+  SIZE_T    private_bytes = 0;
+  SIZE_T    working_set = 0;
+};
+
+
+// -------------------------------- Target --------------------------------- //
+// Reports in on semaphore READY, then holds until event RELEASE is set
+int Hold(const wstring& ready, const wstring& release) {
+  HANDLE semaphore = OpenSemaphoreW(SEMAPHORE_MODIFY_STATE, FALSE,
+                                    ready.c_str());
+  HANDLE event     = OpenEventW(SYNCHRONIZE, FALSE, release.c_str());
+  if (!semaphore || !event)
+    return 1;
+
+  ReleaseSemaphore(semaphore, 1, nullptr);
+  WaitForSingleObject(event, INFINITE);
+  return 0;
+}
+
+
+// --------------------------------- Shims --------------------------------- //
+bool RunAndWait(wstring cmd) {
+  STARTUPINFOW startInfo = {sizeof(startInfo)};
+  PROCESS_INFORMATION processInfo = {};
+  if (!CreateProcessW(nullptr, cmd.data(), nullptr, nullptr, FALSE,
+                      CREATE_NO_WINDOW, nullptr, nullptr,
+                      &startInfo, &processInfo))
+    return false;
+
+  DWORD exit_code = 1;
+  WaitForSingleObject(processInfo.hProcess, INFINITE);
+  GetExitCodeProcess(processInfo.hProcess, &exit_code);
+  CloseHandle(processInfo.hProcess);
+  CloseHandle(processInfo.hThread);
+  return exit_code == 0;
+}
+
+HANDLE Start(wstring cmd) {
+  STARTUPINFOW startInfo = {sizeof(startInfo)};
+  PROCESS_INFORMATION processInfo = {};
+  if (!CreateProcessW(nullptr, cmd.data(), nullptr, nullptr, FALSE,
+                      CREATE_NO_WINDOW, nullptr, nullptr,
+                      &startInfo, &processInfo))
+    return nullptr;
+  CloseHandle(processInfo.hThread);
+  return processInfo.hProcess;
+}
+
+Footprint Measure(HANDLE process) {
+  Footprint footprint;
+  PROCESS_MEMORY_COUNTERS_EX counters = {sizeof(counters)};
+  if (GetProcessMemoryInfo(process, (PROCESS_MEMORY_COUNTERS*)&counters,
+                           sizeof(counters))) {
+    footprint.private_bytes = counters.PrivateUsage;
+    footprint.working_set   = counters.WorkingSetSize;
+  }
+  return footprint;
+}
+
+
+// ------------------------------------------------------------------------- //
+int wmain(int argc, wchar_t* argv[]) {
+  if (argc == 4 && wstring(argv[1]) == L"--hold")
+    return Hold(argv[2], argv[3]);
+
+  if (argc < 2) {
+    cerr << "usage: bench_footprint SHIM_EXEC [--out DIR] [--report FILE]"
+         << " [--count N] [--target KB]\n";
+    return 1;
+  }
+
+  path shim_exec  = absolute(argv[1]);
+  path out_dir    = temp_directory_path() / "shim_bench_footprint";
+  path report;
+  int  count      = 200;
+  SIZE_T target   = 200;
+
+  for (auto& [flag, value] : BenchOptions(argc, argv, 2)) {
+    if (flag == L"--out")     out_dir = absolute(value);
+    if (flag == L"--report")  report = value;
+    if (flag == L"--count")   count = max(1, _wtoi(value.c_str()));
+    if (flag == L"--target")  target = _wtoi(value.c_str());
+  }
+
+  wchar_t self[MAX_PATH];
+  GetModuleFileNameW(nullptr, self, MAX_PATH);
+
+  out_dir = BenchDirectory(out_dir);
+  path shim = out_dir / "holder.exe";
+
+  // The shim for this program
+  if (!RunAndWait(L"\"" + shim_exec.wstring() + L"\" \"" + wstring(self) +
+                  L"\" \"" + shim.wstring() + L"\"")) {
+    cerr << "Could not generate shim with " << shim_exec << "\n";
+    return 1;
+  }
+
+  wstring id      = to_wstring(GetCurrentProcessId());
+  wstring ready   = L"shim_bench_footprint_ready_" + id;
+  wstring release = L"shim_bench_footprint_release_" + id;
+  HANDLE semaphore = CreateSemaphoreW(nullptr, 0, count, ready.c_str());
+  HANDLE event     = CreateEventW(nullptr, TRUE, FALSE, release.c_str());
+
+  // Start them all, then wait for every target to report in
+  vector<HANDLE> shims;
+  wstring cmd = L"\"" + shim.wstring() + L"\" --hold " + ready + L" " +
+                release;
+  for (int i = 0; i < count; i++)
+    if (HANDLE process = Start(cmd))
+      shims.push_back(process);
+
+  int running = 0;
+  while (running < (int)shims.size() &&
+         WaitForSingleObject(semaphore, START_TIMEOUT) == WAIT_OBJECT_0)
+    running++;
+  Sleep(SETTLE_MS);
+
+  vector<Footprint> samples;
+  for (HANDLE process : shims)
+    samples.push_back(Measure(process));
+
+  SetEvent(event);
+  for (HANDLE process : shims) {
+    WaitForSingleObject(process, INFINITE);
+    CloseHandle(process);
+  }
+  CloseHandle(semaphore);
+  CloseHandle(event);
+
+  // ------------------------------- Report -------------------------------- //
+  auto summarize = [&](SIZE_T Footprint::*field, ostringstream& json) {
+    vector<SIZE_T> values;
+    for (const Footprint& sample : samples)
+      values.push_back(sample.*field);
+    sort(values.begin(), values.end());
+    SIZE_T total = 0;
+    for (SIZE_T value : values)
+      total += value;
+    SIZE_T average = values.empty() ? 0 : total / values.size();
+
+    json << "{\"average\": " << average
+         << ", \"median\": " << (values.empty() ? 0 : values[values.size() / 2])
+         << ", \"max\": " << (values.empty() ? 0 : values.back()) << "}";
+    return average;
+  };
+
+  ostringstream json;
+  json << "{\n  \"shim_exec\": " << JsonString(shim_exec.wstring())
+       << ",\n  \"shims\": " << count
+       << ",\n  \"waiting\": " << running
+       << ",\n  \"private_bytes\": ";
+  SIZE_T average = summarize(&Footprint::private_bytes, json);
+  json << ",\n  \"working_set\": ";
+  summarize(&Footprint::working_set, json);
+  bool ok = running == count && average <= target * 1024;
+  json << ",\n  \"target_bytes\": " << target * 1024
+       << ",\n  \"ok\": " << (ok ? "true" : "false") << "\n}\n";
+
+  cerr << running << " of " << count << " shims waiting, "
+       << average / 1024 << " KB private bytes each (target " << target
+       << " KB)\n";
+
+  if (report.empty())
+    cout << json.str();
+  else
+    ofstream(report) << json.str();
+
+  remove_all(out_dir);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,327 @@
+// ------------------------------------------------------------------------- //
+// Generator Throughput Benchmark                                            //
+// ------------------------------------------------------------------------- //
+// Builds a corpus of synthetic source executables (from tiny up to hundreds of
+// MB, with many icons, languages and version blocks) and times how fast
+// SHIM_EXEC turns them into shims. Each generation runs inside a job object so
+// the peak memory of the generator can be read back afterwards.
+//
+// Usage:
+//   bench_generator.exe SHIM_EXEC [--out DIR] [--report FILE] [--runs N]
+//                       [--batch N] [--max-mb N]
+//
+// The report is JSON (stdout unless --report is given) so that two releases
+// can be diffed. Runs headless, natively or under Wine. The corpus and shims
+// go into a new run-N directory in DIR, deleted again at the end.
+// ------------------------------------------------------------------------- //
+#include <windows.h>
+#include "bench.h"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+using namespace std;
+using namespace filesystem;
+
+struct CorpusEntry {
+  string    name;
+  DWORD     payload_mb;       // overlay appended to the image
+  int       icons;            // RT_ICON entries per language
+  int       languages;        // languages for icons and version info
+  int       versions;         // VERSIONINFO blocks per language
+  path      source;
+  ULONGLONG source_bytes = 0;
+};
+
+struct Sample {
+  double    seconds = 0;
+  ULONGLONG bytes = 0;
+  SIZE_T    peak_memory = 0;
+  bool      ok = false;
+};
+
+
+// ---------------------------- Synthetic Images ---------------------------- //
+// A 32bpp icon image: BITMAPINFOHEADER + XOR mask + AND mask
+vector<BYTE> MakeIcon(int size, int seed) {
+  DWORD xor_bytes = size * size * 4;
+  DWORD and_bytes = ((size + 31) / 32) * 4 * size;
+  vector<BYTE> icon(sizeof(BITMAPINFOHEADER) + xor_bytes + and_bytes);
+
+  BITMAPINFOHEADER* header = (BITMAPINFOHEADER*)icon.data();
+  header->biSize        = sizeof(BITMAPINFOHEADER);
+  header->biWidth       = size;
+  header->biHeight      = size * 2;
+  header->biPlanes      = 1;
+  header->biBitCount    = 32;
+
+  for (DWORD i = 0; i < xor_bytes; i++)
+    icon[sizeof(BITMAPINFOHEADER) + i] = (BYTE)(i * 31 + seed);
+  return icon;
+}
+
+#pragma pack(push, 2)
+struct GroupIconEntry {
+  BYTE  width, height, colors, reserved;
+  WORD  planes, bit_count;
+  DWORD bytes;
+  WORD  id;
+};
+#pragma pack(pop)
+
+// A minimal VS_VERSIONINFO holding only the fixed file info
+vector<BYTE> MakeVersion(WORD build) {
+  const wchar_t key[] = L"VS_VERSION_INFO";
+  vector<BYTE> version(6 + sizeof(key) + 2 + sizeof(VS_FIXEDFILEINFO));
+
+  WORD* header = (WORD*)version.data();
+  header[0] = (WORD)version.size();
+  header[1] = sizeof(VS_FIXEDFILEINFO);
+  header[2] = 0;
+  memcpy(version.data() + 6, key, sizeof(key));
+
+  VS_FIXEDFILEINFO* info =
+    (VS_FIXEDFILEINFO*)(version.data() + 6 + sizeof(key) + 2);
+  info->dwSignature       = 0xFEEF04BD;
+  info->dwStrucVersion    = 0x00010000;
+  info->dwFileVersionMS   = 0x00010000;
+  info->dwFileVersionLS   = build;
+  info->dwFileOS          = VOS_NT_WINDOWS32;
+  info->dwFileType        = VFT_APP;
+  return version;
+}
+
+bool MakeSource(const path& seed, CorpusEntry& entry) {
+  if (!CopyFileW(seed.c_str(), entry.source.c_str(), FALSE))
+    return false;
+
+  HANDLE update = BeginUpdateResourceW(entry.source.c_str(), FALSE);
+  if (!update)
+    return false;
+
+  WORD icon_id = 1;
+  for (int lang = 0; lang < entry.languages; lang++) {
+    WORD lang_id = MAKELANGID(LANG_ENGLISH + lang, SUBLANG_DEFAULT);
+
+    // Icons and the group that references them
+    vector<BYTE> group(6 + entry.icons * sizeof(GroupIconEntry));
+    WORD* group_header = (WORD*)group.data();
+    group_header[1] = 1;
+    group_header[2] = (WORD)entry.icons;
+
+    for (int i = 0; i < entry.icons; i++) {
+      int size = 16 << (i % 5);
+      vector<BYTE> icon = MakeIcon(size, i + lang);
+      UpdateResourceW(update, RT_ICON, MAKEINTRESOURCEW(icon_id), lang_id,
+                      icon.data(), (DWORD)icon.size());
+
+      GroupIconEntry* group_entry =
+        (GroupIconEntry*)(group.data() + 6) + i;
+      group_entry->width      = (BYTE)(size >= 256 ? 0 : size);
+      group_entry->height     = group_entry->width;
+      group_entry->planes     = 1;
+      group_entry->bit_count  = 32;
+      group_entry->bytes      = (DWORD)icon.size();
+      group_entry->id         = icon_id++;
+    }
+    UpdateResourceW(update, RT_GROUP_ICON, MAKEINTRESOURCEW(1), lang_id,
+                    group.data(), (DWORD)group.size());
+
+    // Version blocks
+    for (int v = 0; v < entry.versions; v++) {
+      vector<BYTE> version = MakeVersion((WORD)v);
+      UpdateResourceW(update, RT_VERSION, MAKEINTRESOURCEW(v + 1), lang_id,
+                      version.data(), (DWORD)version.size());
+    }
+  }
+
+  if (!EndUpdateResourceW(update, FALSE))
+    return false;
+
+  // Bulk the image up with an overlay so large binaries can be simulated
+  // without compiling them
+  if (entry.payload_mb > 0) {
+    ofstream file(entry.source, ios::binary | ios::app);
+    vector<char> block(1 << 20);
+    for (size_t i = 0; i < block.size(); i++)
+      block[i] = (char)(i * 2654435761u >> 24);
+    for (DWORD mb = 0; mb < entry.payload_mb; mb++)
+      file.write(block.data(), block.size());
+  }
+
+  entry.source_bytes = file_size(entry.source);
+  return true;
+}
+
+
+// ------------------------------ Generation ------------------------------- //
+// Starts one SHIM_EXEC process per output, all assigned to a single job, and
+// waits for them to finish
+Sample Generate(const path& shim_exec, const path& source,
+                const vector<path>& outputs) {
+  Sample sample;
+  HANDLE job = CreateJobObjectW(nullptr, nullptr);
+  vector<HANDLE> processes;
+
+  LARGE_INTEGER frequency, start, stop;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&start);
+
+  for (const path& output : outputs) {
+    wstring cmd = L"\"" + shim_exec.wstring() + L"\" \"" + source.wstring() +
+      L"\" \"" + output.wstring() + L"\"";
+    STARTUPINFOW startInfo = {sizeof(startInfo)};
+    startInfo.dwFlags     = STARTF_USESTDHANDLES;
+    startInfo.hStdOutput  = INVALID_HANDLE_VALUE;
+    startInfo.hStdError   = INVALID_HANDLE_VALUE;
+    PROCESS_INFORMATION processInfo = {};
+
+    if (!CreateProcessW(nullptr, cmd.data(), nullptr, nullptr, TRUE,
+                        CREATE_SUSPENDED | CREATE_NO_WINDOW, nullptr, nullptr,
+                        &startInfo, &processInfo))
+      continue;
+
+    AssignProcessToJobObject(job, processInfo.hProcess);
+    ResumeThread(processInfo.hThread);
+    CloseHandle(processInfo.hThread);
+    processes.push_back(processInfo.hProcess);
+  }
+
+  sample.ok = processes.size() == outputs.size();
+  for (HANDLE process : processes) {
+    WaitForSingleObject(process, INFINITE);
+    DWORD exit_code = 1;
+    GetExitCodeProcess(process, &exit_code);
+    sample.ok = sample.ok && exit_code == 0;
+    CloseHandle(process);
+  }
+
+  QueryPerformanceCounter(&stop);
+  sample.seconds =
+    double(stop.QuadPart - start.QuadPart) / double(frequency.QuadPart);
+
+  JOBOBJECT_EXTENDED_LIMIT_INFORMATION info = {};
+  QueryInformationJobObject(job, JobObjectExtendedLimitInformation,
+                            &info, sizeof(info), nullptr);
+  sample.peak_memory = outputs.size() > 1 ?
+    info.PeakJobMemoryUsed : info.PeakProcessMemoryUsed;
+  CloseHandle(job);
+
+  for (const path& output : outputs) {
+    error_code ec;
+    sample.bytes += file_size(output, ec);
+  }
+  return sample;
+}
+
+
+// ------------------------------------------------------------------------- //
+int wmain(int argc, wchar_t* argv[]) {
+  if (argc < 2) {
+    cerr << "usage: bench_generator SHIM_EXEC [--out DIR] [--report FILE]"
+         << " [--runs N] [--batch N] [--max-mb N]\n";
+    return 1;
+  }
+
+  path shim_exec  = absolute(argv[1]);
+  path out_dir    = temp_directory_path() / "shim_bench";
+  path report;
+  int  runs       = 5;
+  int  batch      = 16;
+  DWORD max_mb    = 256;
+
+  for (auto& [flag, value] : BenchOptions(argc, argv, 2)) {
+    if (flag == L"--out")     out_dir = absolute(value);
+    if (flag == L"--report")  report = value;
+    if (flag == L"--runs")    runs = _wtoi(value.c_str());
+    if (flag == L"--batch")   batch = _wtoi(value.c_str());
+    if (flag == L"--max-mb")  max_mb = _wtoi(value.c_str());
+  }
+
+  wchar_t seed_path[MAX_PATH];
+  GetModuleFileNameW(nullptr, seed_path, MAX_PATH);
+
+  vector<CorpusEntry> corpus = {
+    {"tiny",    0,    1,  1, 1},
+    {"small",   1,    8,  2, 2},
+    {"medium",  32,   32, 4, 4},
+    {"large",   256,  64, 8, 8},
+  };
+
+  // Everything goes into a directory of this run's own under --out
+  out_dir = BenchDirectory(out_dir);
+  create_directories(out_dir / "shims");
+
+  ostringstream json;
+  json << "{\n  \"shim_exec\": " << JsonString(shim_exec.wstring())
+       << ",\n  \"shim_exec_bytes\": " << file_size(shim_exec)
+       << ",\n  \"runs\": " << runs << ",\n  \"batch\": " << batch
+       << ",\n  \"corpus\": [";
+
+  bool first = true;
+  for (CorpusEntry& entry : corpus) {
+    if (entry.payload_mb > max_mb)
+      continue;
+
+    entry.source = out_dir / (entry.name + ".exe");
+    if (!MakeSource(seed_path, entry)) {
+      cerr << "Could not create corpus entry " << entry.name << "\n";
+      return 1;
+    }
+
+    // Single generation: one shim at a time
+    vector<double> seconds;
+    Sample single;
+    for (int run = 0; run < runs; run++) {
+      single = Generate(shim_exec, entry.source,
+                        {out_dir / "shims" / (entry.name + "_single.exe")});
+      seconds.push_back(single.seconds);
+    }
+
+    // Batch generation: BATCH concurrent generator processes
+    vector<path> outputs;
+    for (int i = 0; i < batch; i++)
+      outputs.push_back(
+          out_dir / "shims" / (entry.name + "_" + to_string(i) + ".exe"));
+    Sample batched = Generate(shim_exec, entry.source, outputs);
+
+    double median = Median(seconds);
+    json << (first ? "" : ",") << "\n    {"
+         << "\"name\": \"" << entry.name << "\", "
+         << "\"source_bytes\": " << entry.source_bytes << ", "
+         << "\"icons\": " << entry.icons * entry.languages << ", "
+         << "\"languages\": " << entry.languages << ", "
+         << "\"version_blocks\": " << entry.versions * entry.languages << ",\n"
+         << "     \"single\": {\"ok\": " << (single.ok ? "true" : "false")
+         << ", \"median_seconds\": " << median
+         << ", \"shims_per_second\": " << (median > 0 ? 1 / median : 0)
+         << ", \"bytes_written\": " << single.bytes
+         << ", \"peak_memory\": " << single.peak_memory << "},\n"
+         << "     \"batch\": {\"ok\": " << (batched.ok ? "true" : "false")
+         << ", \"seconds\": " << batched.seconds
+         << ", \"shims_per_second\": "
+         << (batched.seconds > 0 ? batch / batched.seconds : 0)
+         << ", \"bytes_written\": " << batched.bytes
+         << ", \"peak_memory\": " << batched.peak_memory << "}}";
+    first = false;
+
+    cerr << entry.name << ": " << (median > 0 ? 1 / median : 0)
+         << " shims/s single, "
+         << (batched.seconds > 0 ? batch / batched.seconds : 0)
+         << " shims/s batch\n";
+  }
+  json << "\n  ]\n}\n";
+
+  if (report.empty())
+    cout << json.str();
+  else
+    ofstream(report) << json.str();
+
+  remove_all(out_dir);
+  return 0;
+}
@@ -0,0 +1,158 @@
+// ------------------------------------------------------------------------- //
+// Shim Startup Benchmark                                                    //
+// ------------------------------------------------------------------------- //
+// Generates a shim for this program with SHIM_EXEC (and with BASELINE, if
+// given) and launches it many times against a target that exits at once. The
+// time from CreateProcess until the shim has exited, less the same for
+// starting the target directly, is what a shim adds to every launch.
+//
+// Usage:
+//   bench_startup.exe SHIM_EXEC [--baseline SHIM_EXEC] [--out DIR]
+//                     [--report FILE] [--runs N]
+//
+// Each shim is launched without --shim flags (the fast path) and with a few
+// of them (parsed). The report is JSON (stdout unless --report is given) with
+// the median microseconds of every case and, with --baseline, how much faster
+// or slower SHIM_EXEC's shims start. Runs headless, natively or under Wine.
+// The shims are generated into a new run-N directory in DIR and removed
+// with it.
+// ------------------------------------------------------------------------- //
+#include <windows.h>
+#include "bench.h"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+
+using namespace std;
+using namespace filesystem;
+
+#define WARMUP_RUNS 5
+#define SHIM_FLAGS  L" --shim-Timeout 30 --shim-WdType CMD --shim-IoPriority" \
+                    L" NORMAL"
+
+struct Startup {
+  path      shim_exec;
+  double    plain_us = 0;             // median, overhead not subtracted
+  double    flags_us = 0;
+};
+
+
+// ------------------------------------------------------------------------- //
+bool RunAndWait(wstring cmd) {
+  STARTUPINFOW startInfo = {sizeof(startInfo)};
+  PROCESS_INFORMATION processInfo = {};
+  if (!CreateProcessW(nullptr, cmd.data(), nullptr, nullptr, FALSE,
+                      CREATE_NO_WINDOW, nullptr, nullptr,
+                      &startInfo, &processInfo))
+    return false;
+
+  DWORD exit_code = 1;
+  WaitForSingleObject(processInfo.hProcess, INFINITE);
+  GetExitCodeProcess(processInfo.hProcess, &exit_code);
+  CloseHandle(processInfo.hProcess);
+  CloseHandle(processInfo.hThread);
+  return exit_code == 0;
+}
+
+// Median microseconds of starting CMD until it exits
+double TimeLaunch(const wstring& cmd, int runs) {
+  return Time([&] { return RunAndWait(cmd); }, runs, WARMUP_RUNS);
+}
+
+
+// ------------------------------------------------------------------------- //
+int wmain(int argc, wchar_t* argv[]) {
+  if (argc == 2 && wstring(argv[1]) == L"--exit")
+    return 0;
+
+  if (argc < 2) {
+    cerr << "usage: bench_startup SHIM_EXEC [--baseline SHIM_EXEC]"
+         << " [--out DIR] [--report FILE] [--runs N]\n";
+    return 1;
+  }
+
+  vector<Startup> results(1);
+  results[0].shim_exec = absolute(argv[1]);
+  path out_dir    = temp_directory_path() / "shim_bench_startup";
+  path report;
+  int  runs       = 200;
+
+  for (auto& [flag, value] : BenchOptions(argc, argv, 2)) {
+    if (flag == L"--baseline") {
+      results.push_back({});
+      results.back().shim_exec = absolute(value);
+    }
+    if (flag == L"--out")     out_dir = absolute(value);
+    if (flag == L"--report")  report = value;
+    if (flag == L"--runs")    runs = max(1, _wtoi(value.c_str()));
+  }
+
+  wchar_t self[MAX_PATH];
+  GetModuleFileNameW(nullptr, self, MAX_PATH);
+
+  out_dir = BenchDirectory(out_dir);
+
+  double direct_us = TimeLaunch(L"\"" + wstring(self) + L"\" --exit", runs);
+
+  for (size_t n = 0; n < results.size(); n++) {
+    Startup& result = results[n];
+    path shim = out_dir / ("startup_" + to_string(n) + ".exe");
+    if (!RunAndWait(L"\"" + result.shim_exec.wstring() + L"\" \"" +
+                    wstring(self) + L"\" \"" + shim.wstring() + L"\"")) {
+      cerr << "Could not generate shim with " << result.shim_exec << "\n";
+      return 1;
+    }
+
+    wstring cmd = L"\"" + shim.wstring() + L"\"";
+    result.plain_us = TimeLaunch(cmd + L" --exit", runs);
+    result.flags_us = TimeLaunch(cmd + SHIM_FLAGS L" --exit", runs);
+    if (result.plain_us < 0 || result.flags_us < 0) {
+      cerr << "Could not run " << shim << "\n";
+      return 1;
+    }
+  }
+
+  // ------------------------------- Report -------------------------------- //
+  ostringstream json;
+  json << "{\n  \"runs\": " << runs
+       << ",\n  \"direct_us\": " << (long long)direct_us
+       << ",\n  \"shims\": [";
+  for (size_t n = 0; n < results.size(); n++) {
+    const Startup& result = results[n];
+    json << (n ? ",\n" : "\n")
+         << "    {\"shim_exec\": " << JsonString(result.shim_exec.wstring())
+         << ", \"plain_us\": " << (long long)result.plain_us
+         << ", \"flags_us\": " << (long long)result.flags_us
+         << ", \"overhead_us\": " << (long long)(result.plain_us - direct_us)
+         << "}";
+
+    cerr << result.shim_exec.filename() << ": "
+         << (long long)(result.plain_us - direct_us) << " us over "
+         << (long long)direct_us << " us direct, "
+         << (long long)(result.flags_us - direct_us) << " us with flags\n";
+  }
+  json << "\n  ]";
+
+  // Negative when SHIM_EXEC's shims start faster than the baseline's
+  if (results.size() > 1) {
+    double delta = results[0].plain_us - results[1].plain_us;
+    double flags = results[0].flags_us - results[1].flags_us;
+    json << ",\n  \"delta_us\": " << (long long)delta
+         << ",\n  \"delta_flags_us\": " << (long long)flags;
+    cerr << "Startup delta against the baseline: " << (long long)delta
+         << " us (" << (long long)flags << " us with flags)\n";
+  }
+  json << "\n}\n";
+
+  if (report.empty())
+    cout << json.str();
+  else
+    ofstream(report) << json.str();
+
+  remove_all(out_dir);
+  return 0;
+}
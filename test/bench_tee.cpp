@@ -0,0 +1,215 @@
+// ------------------------------------------------------------------------- //
+// Tee Throughput Benchmark                                                  //
+// ------------------------------------------------------------------------- //
+// Generates a shim for this program and times how fast output gets through
+// it, once with the target inheriting the shim's handles directly and once
+// relayed by --shim-Tee. Running the program itself without a shim is the
+// baseline. The benchmark drains the shim's stdout/stderr from a pipe, as a
+// terminal or CI runner would, and checks that every byte arrived (and made
+// it into the tee file).
+//
+// Usage:
+//   bench_tee.exe SHIM_EXEC [--out DIR] [--report FILE] [--runs N] [--mb N]
+//
+// The report is JSON (stdout unless --report is given). Runs headless,
+// natively or under Wine. The shim and the tee file are written to a new
+// run-N directory in DIR, which is removed afterwards.
+// ------------------------------------------------------------------------- //
+#include <windows.h>
+#include "bench.h"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <filesystem>
+
+using namespace std;
+using namespace filesystem;
+
+#define CHUNK_BYTES   (64 * 1024)
+#define STDERR_EVERY  16              // every Nth chunk goes to stderr
+
+struct Sample {
+  double    seconds = 0;
+  ULONGLONG bytes = 0;
+  bool      ok = false;
+};
+
+
+// ------------------------------- Producer -------------------------------- //
+// Writes MB megabytes, mostly to stdout with some chunks on stderr
+int Produce(DWORD mb) {
+  vector<char> chunk(CHUNK_BYTES);
+  for (size_t i = 0; i < chunk.size(); i++)
+    chunk[i] = (char)('a' + i % 26);
+  chunk.back() = '\n';
+
+  HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
+  HANDLE err = GetStdHandle(STD_ERROR_HANDLE);
+  ULONGLONG chunks = (ULONGLONG)mb * (1 << 20) / CHUNK_BYTES;
+
+  for (ULONGLONG i = 0; i < chunks; i++) {
+    DWORD written = 0;
+    HANDLE target = (i % STDERR_EVERY == STDERR_EVERY - 1) ? err : out;
+    if (!WriteFile(target, chunk.data(), CHUNK_BYTES, &written, nullptr))
+      return 1;
+  }
+  return 0;
+}
+
+
+// -------------------------------- Consumer ------------------------------- //
+// Runs CMD with stdout and stderr on one pipe and drains it
+Sample Run(wstring cmd) {
+  Sample sample;
+  HANDLE read_end = nullptr, write_end = nullptr;
+  SECURITY_ATTRIBUTES inherit = {sizeof(inherit), nullptr, TRUE};
+  if (!CreatePipe(&read_end, &write_end, &inherit, 1 << 20))
+    return sample;
+  SetHandleInformation(read_end, HANDLE_FLAG_INHERIT, 0);
+
+  STARTUPINFOW startInfo = {sizeof(startInfo)};
+  startInfo.dwFlags     = STARTF_USESTDHANDLES;
+  startInfo.hStdInput   = GetStdHandle(STD_INPUT_HANDLE);
+  startInfo.hStdOutput  = write_end;
+  startInfo.hStdError   = write_end;
+  PROCESS_INFORMATION processInfo = {};
+
+  LARGE_INTEGER frequency, start, stop;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&start);
+
+  bool started = CreateProcessW(nullptr, cmd.data(), nullptr, nullptr, TRUE,
+                                CREATE_NO_WINDOW, nullptr, nullptr,
+                                &startInfo, &processInfo);
+  CloseHandle(write_end);
+
+  thread drain([&] {
+    vector<char> buffer(1 << 20);
+    DWORD bytes = 0;
+    while (ReadFile(read_end, buffer.data(), (DWORD)buffer.size(),
+                    &bytes, nullptr) && bytes > 0)
+      sample.bytes += bytes;
+  });
+
+  DWORD exit_code = 1;
+  if (started) {
+    WaitForSingleObject(processInfo.hProcess, INFINITE);
+    GetExitCodeProcess(processInfo.hProcess, &exit_code);
+    CloseHandle(processInfo.hProcess);
+    CloseHandle(processInfo.hThread);
+  }
+  drain.join();
+  CloseHandle(read_end);
+
+  QueryPerformanceCounter(&stop);
+  sample.seconds =
+    double(stop.QuadPart - start.QuadPart) / double(frequency.QuadPart);
+  sample.ok = started && exit_code == 0;
+  return sample;
+}
+
+
+// ------------------------------------------------------------------------- //
+int wmain(int argc, wchar_t* argv[]) {
+  if (argc == 3 && wstring(argv[1]) == L"--produce")
+    return Produce(_wtoi(argv[2]));
+
+  if (argc < 2) {
+    cerr << "usage: bench_tee SHIM_EXEC [--out DIR] [--report FILE]"
+         << " [--runs N] [--mb N]\n";
+    return 1;
+  }
+
+  path shim_exec  = absolute(argv[1]);
+  path out_dir    = temp_directory_path() / "shim_bench_tee";
+  path report;
+  int  runs       = 5;
+  DWORD mb        = 2048;
+
+  for (auto& [flag, value] : BenchOptions(argc, argv, 2)) {
+    if (flag == L"--out")     out_dir = absolute(value);
+    if (flag == L"--report")  report = value;
+    if (flag == L"--runs")    runs = _wtoi(value.c_str());
+    if (flag == L"--mb")      mb = _wtoi(value.c_str());
+  }
+
+  wchar_t self[MAX_PATH];
+  GetModuleFileNameW(nullptr, self, MAX_PATH);
+
+  out_dir = BenchDirectory(out_dir);
+  path shim     = out_dir / "producer.exe";
+  path tee_file = out_dir / "tee.log";
+
+  // The shim for this program
+  Sample build = Run(L"\"" + shim_exec.wstring() + L"\" \"" +
+                     wstring(self) + L"\" \"" + shim.wstring() + L"\"");
+  if (!build.ok) {
+    cerr << "Could not generate shim with " << shim_exec << "\n";
+    return 1;
+  }
+
+  ULONGLONG expected =
+    (ULONGLONG)mb * (1 << 20) / CHUNK_BYTES * CHUNK_BYTES;
+  wstring produce = L" --produce " + to_wstring(mb);
+
+  struct Mode {
+    string  name;
+    wstring cmd;
+    bool    tee;
+  };
+  vector<Mode> modes = {
+    {"bare",    L"\"" + wstring(self) + L"\"" + produce, false},
+    {"direct",  L"\"" + shim.wstring() + L"\"" + produce, false},
+    {"tee",     L"\"" + shim.wstring() + L"\" --shim-Tee \"" +
+                tee_file.wstring() + L"\"" + produce, true},
+  };
+
+  ostringstream json;
+  json << "{\n  \"shim_exec\": " << JsonString(shim_exec.wstring())
+       << ",\n  \"runs\": " << runs << ",\n  \"megabytes\": " << mb
+       << ",\n  \"modes\": [";
+
+  double direct_rate = 0;
+  bool first = true;
+  for (const Mode& mode : modes) {
+    vector<double> seconds;
+    bool ok = true;
+    for (int run = 0; run < runs; run++) {
+      Sample sample = Run(mode.cmd);
+      error_code ec;
+      ok = ok && sample.ok && sample.bytes == expected &&
+        (!mode.tee || file_size(tee_file, ec) == expected);
+      seconds.push_back(sample.seconds);
+    }
+
+    double median = Median(seconds);
+    double rate   = median > 0 ? mb / median : 0;
+    if (mode.name == "direct")
+      direct_rate = rate;
+
+    json << (first ? "" : ",") << "\n    {"
+         << "\"name\": \"" << mode.name << "\", "
+         << "\"ok\": " << (ok ? "true" : "false") << ", "
+         << "\"median_seconds\": " << median << ", "
+         << "\"mb_per_second\": " << rate << "}";
+    first = false;
+
+    cerr << mode.name << ": " << rate << " MB/s"
+         << (ok ? "" : " (output incomplete)") << "\n";
+    if (mode.tee && direct_rate > 0)
+      cerr << "tee overhead: " << 100 * (1 - rate / direct_rate) << "%\n";
+  }
+  json << "\n  ]\n}\n";
+
+  if (report.empty())
+    cout << json.str();
+  else
+    ofstream(report) << json.str();
+
+  remove_all(out_dir);
+  return 0;
+}
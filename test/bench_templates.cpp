@@ -0,0 +1,152 @@
+// ------------------------------------------------------------------------- //
+// Template Store Benchmark                                                  //
+// ------------------------------------------------------------------------- //
+// Opens the SHIM_TEMPLATES store of a module (SHIM_EXEC or SHIM_BUILDER.DLL,
+// loaded as a data file) and times reading every variant out of it, without
+// the cache, against generating one shim from that variant in process with
+// the static builder library. Decompressing has to stay a small share of a
+// generation, and with the cache it is paid once per process anyway.
+//
+// Usage:
+//   bench_templates.exe MODULE [--report FILE] [--runs N]
+//
+// The report is JSON (stdout unless --report is given) with the store's size,
+// how every variant is stored (blob or patch), the median microseconds to
+// read it and to build a shim from it, and their ratio. Runs headless,
+// natively or under Wine.
+// ------------------------------------------------------------------------- //
+#include <windows.h>
+#include <template_store.h>
+#include <shim_builder.h>
+#include "bench.h"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+
+using namespace std;
+using namespace filesystem;
+
+struct VariantResult {
+  string    name;
+  bool      patch = false;
+  DWORD     size = 0;
+  double    read_us = 0;            // median, uncached
+  double    cached_us = 0;          // median, TemplateImage after the first
+  double    build_us = 0;           // median, one shim
+};
+
+
+// ------------------------------------------------------------------------- //
+int wmain(int argc, wchar_t* argv[]) {
+  if (argc < 2) {
+    cerr << "usage: bench_templates MODULE [--report FILE] [--runs N]\n";
+    return 1;
+  }
+
+  path module_path = absolute(argv[1]);
+  path report;
+  int  runs = 50;
+  for (auto& [flag, value] : BenchOptions(argc, argv, 2)) {
+    if (flag == L"--report")  report = value;
+    if (flag == L"--runs")    runs = max(1, _wtoi(value.c_str()));
+  }
+
+  HMODULE module = LoadLibraryExW(module_path.c_str(), nullptr,
+                                  LOAD_LIBRARY_AS_DATAFILE |
+                                  LOAD_LIBRARY_AS_IMAGE_RESOURCE);
+  TemplateStoreView store;
+  if (!module || !TemplateStoreOf(module, store)) {
+    cerr << "No template store in " << module_path << "\n";
+    return 1;
+  }
+
+  // This program is the target the shims are built for
+  wchar_t self[MAX_PATH];
+  GetModuleFileNameW(nullptr, self, MAX_PATH);
+  vector<BYTE> source;
+  if (!ReadFileData(self, source)) {
+    cerr << "Could not read " << path(self) << "\n";
+    return 1;
+  }
+
+  vector<VariantResult> results;
+  ULONGLONG total = 0;
+  for (DWORD i = 0; i < store.header->variants; i++) {
+    const TemplateStoreVariant& variant = store.variants[i];
+    VariantResult result;
+    result.name   = variant.name;
+    result.patch  = variant.patchSize != 0;
+    result.size   = variant.size;
+    total        += variant.size;
+
+    vector<BYTE> image;
+    result.read_us = Time([&] {
+      return TemplateStoreRead(store, result.name, image);
+    }, runs);
+    result.cached_us = Time([&] {
+      return TemplateImage(module, result.name) != nullptr;
+    }, runs);
+
+    // Only templates of this computer's architecture make sense to build
+    // with here, but the builder does not run them, so all are timed
+    ShimBuildConfig config = {sizeof(config)};
+    config.path           = self;
+    config.type           = result.name.find("GUI") != string::npos ?
+                            L"GUI" : L"CONSOLE";
+    config.timeout        = L"30";
+    config.templateImage  = image.data();
+    config.templateSize   = image.size();
+    vector<BYTE> shim;
+    result.build_us = Time([&] {
+      return ShimBuild(config, source.data(), source.size(), shim) ==
+             SHIM_BUILD_OK;
+    }, runs);
+
+    if (result.read_us < 0 || result.cached_us < 0 || result.build_us < 0) {
+      cerr << "Could not read or build " << result.name << "\n";
+      return 1;
+    }
+    results.push_back(result);
+  }
+
+  // ------------------------------- Report -------------------------------- //
+  ostringstream json;
+  json << "{\n  \"module\": \"" << module_path.filename().string() << "\""
+       << ",\n  \"runs\": " << runs
+       << ",\n  \"store_bytes\": " << store.size
+       << ",\n  \"template_bytes\": " << total
+       << ",\n  \"variants\": [";
+  for (size_t n = 0; n < results.size(); n++) {
+    const VariantResult& result = results[n];
+    double share = result.read_us / result.build_us;
+    json << (n ? ",\n" : "\n")
+         << "    {\"name\": \"" << result.name << "\""
+         << ", \"stored\": \"" << (result.patch ? "patch" : "blob") << "\""
+         << ", \"bytes\": " << result.size
+         << ", \"read_us\": " << (long long)result.read_us
+         << ", \"cached_us\": " << result.cached_us
+         << ", \"build_us\": " << (long long)result.build_us
+         << ", \"read_share\": " << share << "}";
+
+    cerr << result.name << ": " << (long long)result.read_us << " us to read ("
+         << (result.patch ? "patch" : "blob") << "), "
+         << (long long)result.build_us << " us to build, "
+         << (long long)(share * 100) << "% of a shim\n";
+  }
+  json << "\n  ]\n}\n";
+
+  cerr << "Store: " << store.size / 1024 << " KB for " << total / 1024
+       << " KB of templates\n";
+
+  if (report.empty())
+    cout << json.str();
+  else
+    ofstream(report) << json.str();
+
+  FreeLibrary(module);
+  return 0;
+}
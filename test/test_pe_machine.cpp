@@ -0,0 +1,218 @@
+// ------------------------------------------------------------------------- //
+// Template Architecture Tests                                               //
+// ------------------------------------------------------------------------- //
+// Checks PeMachine and ShimMachine of PE_MACHINE.H on synthetic images: x86,
+// x64 and ARM64 executables, .NET images (AnyCPU, 32 bit required, x64) and
+// truncated or corrupt headers, which must give 0 or the file header's
+// machine but never read past the image. Prints every failed check and exits
+// with 1 if there was one.
+//
+// Usage:
+//   test_pe_machine
+//
+// Only needs the standard library: builds with MSVC (nmake test), mingw and
+// on Linux, e.g.
+//   g++ -std=c++17 -Wall -I../include test_pe_machine.cpp -o test_pe_machine
+// ------------------------------------------------------------------------- //
+#include <pe_machine.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+#define HEADER      0x80              // e_lfanew of the synthetic images
+#define COR_RVA     0x2000            // where the CLR header is mapped
+#define COR_OFFSET  0x200             // and where it is in the file
+
+static int failures = 0;
+
+#define CHECK_EQUAL(actual, expected)                                       \
+  do {                                                                      \
+    auto a = (actual);                                                      \
+    auto e = (expected);                                                    \
+    if (a != e) {                                                           \
+      cerr << __FILE__ << ":" << __LINE__ << ": " #actual " is 0x" << hex  \
+           << (unsigned)a << ", expected 0x" << (unsigned)e << dec << "\n"; \
+      failures++;                                                           \
+    }                                                                       \
+  } while (0)
+
+
+// ------------------------------- Images ---------------------------------- //
+void Write(vector<uint8_t>& image, size_t at, uint32_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; i++)
+    image[at + i] = (uint8_t)(value >> (8 * i));
+}
+
+// A headers only image of MACHINE with one section. With a CLR header of
+// COR_FLAGS, unless NET is false. PE32+ for x64 and ARM64, like the linker.
+vector<uint8_t> Image(uint16_t machine, bool net = false,
+                      uint32_t cor_flags = 0) {
+  bool   plus     = machine != PE_MACHINE_X86;
+  size_t optional = HEADER + 24;
+  size_t length   = plus ? 0xF0 : 0xE0;
+  size_t dirs     = optional + (plus ? 112 : 96);
+
+  vector<uint8_t> image(0x400);
+  image[0] = 'M';
+  image[1] = 'Z';
+  Write(image, 0x3C, HEADER, 4);
+  memcpy(&image[HEADER], "PE\0\0", 4);
+  Write(image, HEADER + 4, machine, 2);
+  Write(image, HEADER + 6, 1, 2);                       // sections
+  Write(image, HEADER + 20, (uint32_t)length, 2);
+  Write(image, optional, plus ? 0x20B : 0x10B, 2);
+  Write(image, dirs - 4, 16, 4);                        // NumberOfRvaAndSizes
+
+  size_t section = optional + length;
+  memcpy(&image[section], ".text\0\0\0", 8);
+  Write(image, section + 8, 0x200, 4);                  // VirtualSize
+  Write(image, section + 12, COR_RVA, 4);
+  Write(image, section + 16, 0x200, 4);                 // SizeOfRawData
+  Write(image, section + 20, COR_OFFSET, 4);
+
+  if (net) {
+    Write(image, dirs + 14 * 8, COR_RVA, 4);
+    Write(image, dirs + 14 * 8 + 4, 72, 4);
+    Write(image, COR_OFFSET, 72, 4);                    // cb
+    Write(image, COR_OFFSET + 16, cor_flags, 4);
+  }
+  return image;
+}
+
+uint16_t Machine(const vector<uint8_t>& image) {
+  return PeMachine(image.data(), image.size());
+}
+
+uint16_t Machine(const vector<uint8_t>& image, size_t size) {
+  return PeMachine(image.data(), size);
+}
+
+
+// -------------------------------- Tests ---------------------------------- //
+void TestNative() {
+  CHECK_EQUAL(Machine(Image(PE_MACHINE_X86)), PE_MACHINE_X86);
+  CHECK_EQUAL(Machine(Image(PE_MACHINE_X64)), PE_MACHINE_X64);
+  CHECK_EQUAL(Machine(Image(PE_MACHINE_ARM64)), PE_MACHINE_ARM64);
+  // Machines without a template are still reported; ShimMachine skips them
+  CHECK_EQUAL(Machine(Image(0x01C4)), 0x01C4);          // ARMNT
+}
+
+void TestNet() {
+  // AnyCPU: x86 in the header, but runs natively wherever it is started
+  CHECK_EQUAL(Machine(Image(PE_MACHINE_X86, true, PE_COR_ILONLY)), 0);
+  CHECK_EQUAL(Machine(Image(PE_MACHINE_X86, true,
+                            PE_COR_ILONLY | 0x00010000)), 0);  // signed
+
+  // 32 bit required (or preferred, which comes with it) and mixed mode
+  // images run as x86
+  CHECK_EQUAL(Machine(Image(PE_MACHINE_X86, true,
+                            PE_COR_ILONLY | PE_COR_32BITREQUIRED)),
+              PE_MACHINE_X86);
+  CHECK_EQUAL(Machine(Image(PE_MACHINE_X86, true,
+                            PE_COR_ILONLY | PE_COR_32BITREQUIRED |
+                            0x00020000)), PE_MACHINE_X86);
+  CHECK_EQUAL(Machine(Image(PE_MACHINE_X86, true, 0)), PE_MACHINE_X86);
+
+  // Built for x64 or ARM64 only
+  CHECK_EQUAL(Machine(Image(PE_MACHINE_X64, true, PE_COR_ILONLY)),
+              PE_MACHINE_X64);
+  CHECK_EQUAL(Machine(Image(PE_MACHINE_ARM64, true, PE_COR_ILONLY)),
+              PE_MACHINE_ARM64);
+
+  // The CLR header outside of every section
+  vector<uint8_t> image = Image(PE_MACHINE_X86, true, PE_COR_ILONLY);
+  Write(image, HEADER + 24 + 96 + 14 * 8, 0x9000, 4);
+  CHECK_EQUAL(Machine(image), PE_MACHINE_X86);
+}
+
+void TestTruncated() {
+  vector<uint8_t> image = Image(PE_MACHINE_X64);
+  CHECK_EQUAL(Machine(image, 0), 0);
+  CHECK_EQUAL(Machine(image, 0x3F), 0);                 // no e_lfanew
+  CHECK_EQUAL(Machine(image, HEADER), 0);               // no signature
+  CHECK_EQUAL(Machine(image, HEADER + 5), 0);           // half a machine
+  CHECK_EQUAL(Machine(image, HEADER + 6), PE_MACHINE_X64);
+  CHECK_EQUAL(PeMachine(nullptr, 0x400), 0);
+
+  // An AnyCPU image cut anywhere before its flags reads as what its file
+  // header says
+  vector<uint8_t> net = Image(PE_MACHINE_X86, true, PE_COR_ILONLY);
+  for (size_t size : {(size_t)HEADER + 6, (size_t)HEADER + 24,
+                      (size_t)HEADER + 24 + 0xE0,
+                      (size_t)HEADER + 24 + 0xE0 + 39,
+                      (size_t)COR_OFFSET, (size_t)COR_OFFSET + 19})
+    CHECK_EQUAL(Machine(net, size), PE_MACHINE_X86);
+  CHECK_EQUAL(Machine(net, COR_OFFSET + 20), 0);
+}
+
+void TestCorrupt() {
+  string script = "@echo off\r\necho %*\r\n" + string(0x80, ' ');
+  CHECK_EQUAL(PeMachine((const uint8_t*)script.data(), script.size()), 0);
+
+  vector<uint8_t> image = Image(PE_MACHINE_X64);
+  image[1] = 'X';
+  CHECK_EQUAL(Machine(image), 0);
+
+  image = Image(PE_MACHINE_X64);
+  image[HEADER + 1] = 'X';
+  CHECK_EQUAL(Machine(image), 0);
+
+  for (uint32_t lfanew : {0x400u, 0x3FBu, 0xFFFFFFFFu, 0x80000000u}) {
+    image = Image(PE_MACHINE_X64);
+    Write(image, 0x3C, lfanew, 4);
+    CHECK_EQUAL(Machine(image), 0);
+  }
+
+  // Section tables and optional headers claiming more than the file holds
+  image = Image(PE_MACHINE_X86, true, PE_COR_ILONLY);
+  Write(image, HEADER + 6, 0xFFFF, 2);
+  CHECK_EQUAL(Machine(image), PE_MACHINE_X86);
+
+  image = Image(PE_MACHINE_X86, true, PE_COR_ILONLY);
+  Write(image, HEADER + 20, 0xFFFF, 2);
+  CHECK_EQUAL(Machine(image), PE_MACHINE_X86);
+
+  image = Image(PE_MACHINE_X86, true, PE_COR_ILONLY);
+  Write(image, HEADER + 24 + 92, 2, 4);                 // no CLR directory
+  CHECK_EQUAL(Machine(image), PE_MACHINE_X86);
+
+  // A section placing the CLR header at the end of the address space
+  image = Image(PE_MACHINE_X86, true, PE_COR_ILONLY);
+  Write(image, HEADER + 24 + 0xE0 + 20, 0xFFFFFFF0u, 4);
+  CHECK_EQUAL(Machine(image), PE_MACHINE_X86);
+}
+
+void TestShimMachine() {
+  uint16_t anycpu = Machine(Image(PE_MACHINE_X86, true, PE_COR_ILONLY));
+  CHECK_EQUAL(ShimMachine(anycpu, PE_MACHINE_ARM64, L""), PE_MACHINE_ARM64);
+  CHECK_EQUAL(ShimMachine(anycpu, PE_MACHINE_X64, L"target"), PE_MACHINE_X64);
+  CHECK_EQUAL(ShimMachine(PE_MACHINE_X86, PE_MACHINE_ARM64, L""),
+              PE_MACHINE_X86);
+  CHECK_EQUAL(ShimMachine(PE_MACHINE_X86, PE_MACHINE_ARM64, L"Host"),
+              PE_MACHINE_ARM64);
+  CHECK_EQUAL(ShimMachine(0x01C4, PE_MACHINE_X64, L""), PE_MACHINE_X64);
+  CHECK_EQUAL(ShimMachine(0, 0, L""), PE_MACHINE_X64);
+  CHECK_EQUAL(ShimMachine(0, PE_MACHINE_X64, L"amd64"), PE_MACHINE_X64);
+  CHECK_EQUAL(ShimMachine(0, PE_MACHINE_X64, L"ia64"), 0);
+}
+
+
+// ------------------------------------------------------------------------- //
+int main() {
+  TestNative();
+  TestNet();
+  TestTruncated();
+  TestCorrupt();
+  TestShimMachine();
+
+  if (failures) {
+    cerr << failures << " check(s) failed\n";
+    return 1;
+  }
+  cerr << "All checks passed\n";
+  return 0;
+}
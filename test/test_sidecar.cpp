@@ -0,0 +1,159 @@
+// ------------------------------------------------------------------------- //
+// Sidecar Tests                                                             //
+// ------------------------------------------------------------------------- //
+// Checks the text handling of SIDECAR.H: ParseSidecar on quoting, byte order
+// marks, duplicate keys, dashes in keys, comments and lines without =,
+// FormatSidecar and RewriteSidecar on values with line breaks, and that
+// RewriteSidecar keeps everything but the lines it changes. Prints every
+// failed check and exits with 1 if there was one.
+//
+// Usage:
+//   test_sidecar
+//
+// Needs windows.h for the UTF-8 conversions, but no file is touched.
+// ------------------------------------------------------------------------- //
+#include <sidecar.h>
+#include <string>
+#include <map>
+#include <iostream>
+
+using namespace std;
+
+static int failures = 0;
+
+#define CHECK(condition)                                                    \
+  do {                                                                      \
+    if (!(condition)) {                                                     \
+      cerr << __FILE__ << ":" << __LINE__ << ": " #condition " failed\n";  \
+      failures++;                                                           \
+    }                                                                       \
+  } while (0)
+
+map<string, wstring> Parse(string_view text) {
+  map<string, wstring> settings;
+  ParseSidecar(text, settings);
+  return settings;
+}
+
+
+// ------------------------------- Parsing --------------------------------- //
+void TestQuoting() {
+  auto settings = Parse("path = \"C:\\Tools\\my app\\app.exe\"\n"
+                        "args = \"a b\" c\n"
+                        "wd_path = \"C:\\work\"\n"
+                        "timeout = \"30\n");
+  CHECK(settings["SHIM_PATH"] == L"C:\\Tools\\my app\\app.exe");
+  // ARGS keeps its quotes, they are the target's
+  CHECK(settings["SHIM_ARGS"] == L"\"a b\" c");
+  CHECK(settings["WD_PATH"] == L"C:\\work");
+  // Only a value quoted on both ends is unquoted
+  CHECK(settings["SHIM_TIMEOUT"] == L"\"30");
+
+  settings = Parse("args = \"only quoted\"\npath = \"\"\n");
+  CHECK(settings["SHIM_ARGS"] == L"\"only quoted\"");
+  CHECK(settings.count("SHIM_PATH") && settings["SHIM_PATH"].empty());
+}
+
+void TestEncoding() {
+  auto settings = Parse("\xEF\xBB\xBFpath = C:\\a.exe\r\nargs = x\r\n");
+  CHECK(settings["SHIM_PATH"] == L"C:\\a.exe");
+  CHECK(settings["SHIM_ARGS"] == L"x");
+
+  // UTF-8 values, and a byte order mark only counts at the start
+  settings = Parse("path = C:\\\xC3\xA9t\xC3\xA9\\a.exe\n"
+                   "\xEF\xBB\xBFargs = x\n");
+  CHECK(settings["SHIM_PATH"] == L"C:\\\u00E9t\u00E9\\a.exe");
+  CHECK(!settings.count("SHIM_ARGS"));
+}
+
+void TestKeys() {
+  map<string, wstring> settings;
+  CHECK(ParseSidecar("timeout = 10\nTIMEOUT = 20\n", settings) == 2);
+  CHECK(settings["SHIM_TIMEOUT"] == L"20");
+
+  settings = Parse("Wd-Type = PATH\n  memory-limit=512M  \n"
+                   "JOB_MEMORY_LIMIT = 1G\n");
+  CHECK(settings["WD_TYPE"] == L"PATH");
+  CHECK(settings["LIMIT_PROCESS_MEMORY"] == L"512M");
+  CHECK(settings["LIMIT_JOB_MEMORY"] == L"1G");
+}
+
+void TestSkipped() {
+  map<string, wstring> settings;
+  CHECK(ParseSidecar("# path = C:\\a.exe\n; args = x\n\n   \n"
+                     "path C:\\b.exe\nunknown = 1\n= 2\n", settings) == 0);
+  CHECK(settings.empty());
+  CHECK(ParseSidecar("", settings) == 0);
+
+  // The first = splits, the rest is the value
+  settings = Parse("args = --define=a=b\n");
+  CHECK(settings["SHIM_ARGS"] == L"--define=a=b");
+}
+
+
+// ------------------------------- Writing --------------------------------- //
+void TestFormat() {
+  map<string, wstring> settings = {{"SHIM_PATH", L"C:\\my app\\a.exe"},
+                                   {"SHIM_ARGS", L"\"a b\""},
+                                   {"SHIM_TIMEOUT", L""}};
+  string text;
+  CHECK(FormatSidecar(settings, text));
+  CHECK(text == "path = \"C:\\my app\\a.exe\"\r\nargs = \"a b\"\r\n");
+
+  settings.erase("SHIM_TIMEOUT");
+  CHECK(Parse(text) == settings);
+
+  // A line break would start a setting of its own
+  CHECK(!FormatSidecar({{"SHIM_ARGS", L"x\r\ntimeout = 1"}}, text));
+  CHECK(!FormatSidecar({{"SHIM_PATH", L"C:\\a\n.exe"}}, text));
+}
+
+void TestRewrite() {
+  string text = "\xEF\xBB\xBF# Managed by hand\r\n"
+                "path = \"C:\\old\\a.exe\"\r\n"
+                "\r\n"
+                "; working directory\n"
+                "wd-path=C:\\old\\work\n"
+                "custom = kept\r\n"
+                "path = C:\\old\\b.exe";
+  string output;
+  CHECK(RewriteSidecar(text, {{"SHIM_PATH", L"C:\\new\\a.exe"},
+                              {"WD_PATH", L"C:\\new\\work"}}, output));
+  CHECK(output == "\xEF\xBB\xBF# Managed by hand\r\n"
+                  "path = \"C:\\new\\a.exe\"\r\n"
+                  "\r\n"
+                  "; working directory\n"
+                  "wd_path = C:\\new\\work\n"
+                  "custom = kept\r\n"
+                  "path = \"C:\\new\\a.exe\"");
+
+  // Keys the sidecar lacks go at its end, on a line of their own
+  CHECK(RewriteSidecar("args = x", {{"WD_PATH", L"C:\\w"}}, output));
+  CHECK(output == "args = x\r\nwd_path = C:\\w\r\n");
+  CHECK(RewriteSidecar("", {{"SHIM_PATH", L"C:\\a.exe"}}, output));
+  CHECK(output == "path = \"C:\\a.exe\"\r\n");
+
+  // Nothing to change leaves the text as it was
+  CHECK(RewriteSidecar(text, {}, output) && output == text);
+
+  CHECK(!RewriteSidecar(text, {{"SHIM_PATH", L"C:\\a\r\nargs = x"}},
+                        output));
+}
+
+
+// ------------------------------------------------------------------------- //
+int main() {
+  TestQuoting();
+  TestEncoding();
+  TestKeys();
+  TestSkipped();
+  TestFormat();
+  TestRewrite();
+
+  if (failures) {
+    cerr << failures << " check(s) failed\n";
+    return 1;
+  }
+  cerr << "All checks passed\n";
+  return 0;
+}
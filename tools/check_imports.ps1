@@ -0,0 +1,38 @@
+# Fails the build if a shim template imports anything beyond KERNEL32 and the
+# CRT. Every DLL in the import table (and its own dependencies) is loaded on
+# every launch of every shim, so helpers needed only on rare paths (e.g.
+# ShellExecuteExW for elevation) must be bound at runtime instead.
+param(
+    [Parameter(Mandatory, ValueFromRemainingArguments)]
+    [string[]] $Path
+)
+
+$allowed = '^(KERNEL32|VCRUNTIME140(_1)?|MSVCP140(_\d+)?|api-ms-win-crt-[a-z-]+-l\d-\d-\d)\.dll$'
+$failed  = $false
+
+foreach ($exe in $Path) {
+    $output = dumpbin -nologo -imports $exe
+    if ($LASTEXITCODE -ne 0) {
+        Write-Host "dumpbin failed on $exe (exit code $LASTEXITCODE)"
+        $failed = $true
+        continue
+    }
+    $imports = $output | ForEach-Object {
+        if ($_ -match '^\s+(\S+\.dll)$') { $Matches[1] }
+    }
+
+    # Every template imports KERNEL32; without it the listing was not read
+    if ($imports -notcontains 'KERNEL32.dll') {
+        Write-Host "$exe lists no KERNEL32.dll import, could not check it"
+        $failed = $true
+        continue
+    }
+
+    $extra = $imports | Where-Object { $_ -notmatch $allowed } | Sort-Object -Unique
+    if ($extra) {
+        Write-Host "$exe imports $($extra -join ', ')"
+        $failed = $true
+    }
+}
+
+if ($failed) { exit 1 }
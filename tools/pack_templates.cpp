@@ -0,0 +1,194 @@
+// ------------------------------------------------------------------------- //
+// Template Packer                                                           //
+// ------------------------------------------------------------------------- //
+// Packs the shim templates into the SHIM_TEMPLATES store embedded in
+// SHIM_EXEC.EXE and SHIM_BUILDER.DLL (the format is in TEMPLATE_STORE.H).
+// Built and run by the makefile:
+//
+//   pack_templates.exe OUTPUT NAME=FILE...
+//
+//   e.g. pack_templates.exe shim_templates.bin SHIM_CONSOLE=shim_console.exe
+//            SHIM_GUI=shim_gui.exe SHIM_GUI_ARM64=shim_gui_arm64.exe
+//
+// A template of the same size as one already packed that differs from it in
+// few bytes (the other subsystem of the same architecture) is stored as a
+// patch of it; all others are compressed. The output only depends on the
+// inputs and their order, so reproducible builds stay reproducible.
+// ------------------------------------------------------------------------- //
+#include <template_store.h>
+#include <utility_functions.h>
+#include <iostream>
+
+using namespace std;
+
+// Largest patch, as a share of the template, worth storing over a blob
+#define PATCH_SHARE   8
+// Unchanged bytes a run of changes may span rather than start a new run
+#define PATCH_GAP     (2 * sizeof(DWORD))
+
+struct Packed {
+  string        name;
+  vector<BYTE>  image;
+  DWORD         blob = 0;
+  vector<BYTE>  patch;
+};
+
+void Append(vector<BYTE>& data, const void* value, size_t size) {
+  data.insert(data.end(), (const BYTE*)value, (const BYTE*)value + size);
+}
+
+// Runs of {offset, length, bytes} turning BASE into IMAGE (of the same size)
+vector<BYTE> Diff(const vector<BYTE>& base, const vector<BYTE>& image) {
+  vector<BYTE> patch;
+  size_t i = 0;
+  while (i < image.size()) {
+    if (base[i] == image[i]) {
+      i++;
+      continue;
+    }
+
+    size_t start = i, end = i + 1, same = 0;
+    for (i++; i < image.size() && same <= PATCH_GAP; i++) {
+      if (base[i] == image[i])
+        same++;
+      else {
+        same = 0;
+        end = i + 1;
+      }
+    }
+    DWORD offset = (DWORD)start;
+    DWORD length = (DWORD)(end - start);
+    Append(patch, &offset, sizeof(offset));
+    Append(patch, &length, sizeof(length));
+    Append(patch, image.data() + start, length);
+    i = end;
+  }
+  return patch;
+}
+
+bool CompressImage(const vector<BYTE>& image, vector<BYTE>& stored) {
+  COMPRESSOR_HANDLE compressor = nullptr;
+  if (!CreateCompressor(TEMPLATE_STORE_ALGORITHM, nullptr, &compressor))
+    return false;
+
+  SIZE_T size = 0;
+  Compress(compressor, image.data(), image.size(), nullptr, 0, &size);
+  stored.resize(size);
+  bool ok = Compress(compressor, image.data(), image.size(), stored.data(),
+                     stored.size(), &size);
+  stored.resize(size);
+  CloseCompressor(compressor);
+  return ok;
+}
+
+
+// ------------------------------------------------------------------------- //
+int wmain(int argc, wchar_t* argv[]) {
+  if (argc < 3) {
+    cerr << "usage: pack_templates OUTPUT NAME=FILE...\n";
+    return 1;
+  }
+
+  vector<Packed> variants;
+  vector<size_t> blobs;                 // variant each blob is the image of
+  size_t         input = 0;
+  for (int i = 2; i < argc; i++) {
+    wstring arg   = argv[i];
+    size_t  equal = arg.find(L'=');
+    Packed  variant;
+    variant.name  = NarrowString(arg.substr(0, equal));
+    if (equal == wstring::npos || variant.name.empty() ||
+        variant.name.size() >= TEMPLATE_STORE_NAME ||
+        !ReadFileData(arg.substr(equal + 1), variant.image)) {
+      cerr << "Could not read " << NarrowString(arg) << "\n";
+      return 1;
+    }
+    input += variant.image.size();
+
+    // A patch of the closest blob of the same size, if it is small enough
+    bool patched = false;
+    for (size_t b = 0; b < blobs.size(); b++) {
+      const vector<BYTE>& base = variants[blobs[b]].image;
+      if (base.size() != variant.image.size())
+        continue;
+      vector<BYTE> patch = Diff(base, variant.image);
+      if (patch.size() * PATCH_SHARE < variant.image.size() &&
+          (!patched || patch.size() < variant.patch.size())) {
+        variant.blob  = (DWORD)b;
+        variant.patch = move(patch);
+        patched       = true;
+      }
+    }
+    if (!patched) {
+      variant.blob = (DWORD)blobs.size();
+      blobs.push_back(variants.size());
+    }
+    variants.push_back(move(variant));
+  }
+
+  // ---------- Layout ---------- //
+  TemplateStoreHeader header = {TEMPLATE_STORE_MAGIC, TEMPLATE_STORE_VERSION,
+                                (DWORD)variants.size(), (DWORD)blobs.size()};
+  size_t offset = sizeof(header) +
+                  variants.size() * sizeof(TemplateStoreVariant) +
+                  blobs.size() * sizeof(TemplateStoreBlob);
+
+  vector<BYTE> data;
+  vector<TemplateStoreBlob> blobIndex;
+  for (size_t variant : blobs) {
+    vector<BYTE> stored;
+    if (!CompressImage(variants[variant].image, stored)) {
+      cerr << "Could not compress " << variants[variant].name << "\n";
+      return 1;
+    }
+    blobIndex.push_back({TEMPLATE_STORE_ALGORITHM, (DWORD)(offset + data.size()),
+                         (DWORD)stored.size(),
+                         (DWORD)variants[variant].image.size()});
+    Append(data, stored.data(), stored.size());
+  }
+
+  vector<TemplateStoreVariant> variantIndex;
+  for (Packed& variant : variants) {
+    TemplateStoreVariant entry = {};
+    strcpy_s(entry.name, variant.name.c_str());
+    entry.blob      = variant.blob;
+    entry.patch     = variant.patch.empty() ? 0 :
+                      (DWORD)(offset + data.size());
+    entry.patchSize = (DWORD)variant.patch.size();
+    entry.size      = (DWORD)variant.image.size();
+    variantIndex.push_back(entry);
+    Append(data, variant.patch.data(), variant.patch.size());
+  }
+
+  vector<BYTE> store;
+  Append(store, &header, sizeof(header));
+  Append(store, variantIndex.data(),
+         variantIndex.size() * sizeof(TemplateStoreVariant));
+  Append(store, blobIndex.data(), blobIndex.size() * sizeof(TemplateStoreBlob));
+  Append(store, data.data(), data.size());
+
+  // Read back every variant before it is embedded anywhere
+  TemplateStoreView view;
+  if (!TemplateStoreOpen(store.data(), store.size(), view)) {
+    cerr << "Packed store is not readable\n";
+    return 1;
+  }
+  for (const Packed& variant : variants) {
+    vector<BYTE> image;
+    if (!TemplateStoreRead(view, variant.name, image) ||
+        image != variant.image) {
+      cerr << "Packed " << variant.name << " does not read back\n";
+      return 1;
+    }
+  }
+
+  if (!WriteFileData(argv[1], store)) {
+    cerr << "Could not write " << NarrowString(argv[1]) << "\n";
+    return 1;
+  }
+
+  cout << "Packed " << variants.size() << " templates (" << blobs.size()
+       << " compressed, " << variants.size() - blobs.size() << " patched): "
+       << input / 1024 << " KB into " << store.size() / 1024 << " KB\n";
+  return 0;
+}
@@ -0,0 +1,66 @@
+# Trains the instrumented shim templates for profile guided optimization
+# (nmake pgo). SHIM_EXEC must embed the templates linked with -GENPROFILE; it
+# shims CMD.EXE as a console and as a GUI shim and launches them the ways
+# shims are used: without flags (the fast path), with --shim-* flags, with a
+# long command line, waiting and not waiting, logging and with embedded
+# settings. Every launch writes its counts to a .pgc file next to the .pgd
+# files in the current directory, which the -USEPROFILE link merges.
+#
+# The instrumented shims load PGORT140.DLL, so run it from a Visual Studio
+# developer prompt (as nmake is).
+param(
+    [Parameter(Mandatory)] [string] $ShimExec,
+    [int] $Runs = 20
+)
+
+$ErrorActionPreference = 'Stop'
+$env:VCPROFILE_PATH = (Get-Location).Path
+
+$dir = Join-Path $env:TEMP 'shim_pgo_train'
+Remove-Item $dir -Recurse -Force -ErrorAction SilentlyContinue
+New-Item -ItemType Directory $dir | Out-Null
+
+function Shim([string] $Name, [string[]] $Settings) {
+    $output = Join-Path $dir "$Name.exe"
+    & $ShimExec $env:ComSpec $output @Settings | Out-Null
+    if ($LASTEXITCODE -ne 0) { throw "Could not create $output" }
+    $output
+}
+
+function Launch([string] $Shim, [string] $Arguments) {
+    $process = Start-Process $Shim -ArgumentList $Arguments -NoNewWindow `
+                             -Wait -PassThru -WorkingDirectory $dir `
+                             -RedirectStandardOutput (Join-Path $dir 'out.txt')
+    $process.ExitCode
+}
+
+$console  = Shim 'console'
+$gui      = Shim 'gui' @('--gui')
+$settings = Shim 'settings' @('--command', '/d', '--timeout', '60',
+                              '--wd-type', 'APP', '--priority', 'BELOW_NORMAL',
+                              '--power-throttling', 'OFF')
+
+$long = '/d /c rem' + (' C:\src\project\module\file.cpp' * 250)
+
+$workload = @(
+    @($console,  '/d /c exit 0'),
+    @($console,  '/d /c exit 3'),
+    @($console,  '--shim-Timeout 30 --shim-WdType SHIM /d /c exit 0'),
+    @($console,  '--shim-IoPriority LOW --shim-MemoryPriority LOW /d /c exit 0'),
+    @($console,  '--shim-Exit /d /c exit 0'),
+    @($console,  '--shim-NoOp /d /c exit 0'),
+    @($console,  $long),
+    @($settings, '/c exit 0'),
+    @($gui,      '/d /c exit 0'),
+    @($gui,      '--shim-Wait /d /c exit 0'),
+    @($gui,      '--shim-Log --shim-Wait /d /c exit 0')
+)
+
+for ($i = 0; $i -lt $Runs; $i++) {
+    foreach ($launch in $workload) {
+        Launch $launch[0] $launch[1] | Out-Null
+    }
+}
+
+Write-Host "Trained with $($Runs * $workload.Count) launches"
+Remove-Item $dir -Recurse -Force -ErrorAction SilentlyContinue